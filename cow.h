@@ -0,0 +1,240 @@
+// cow.h
+// Copy-on-write helpers for data shared between ERP data generations.
+// A published generation is never changed again, but the next one is built
+// from the same nodes: a writer may change a node in place only while its
+// generation holds the only reference to it, and copies it first otherwise.
+
+#ifndef COW_H
+#define COW_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+namespace Cow {
+
+// true when 'p' holds the only reference to its object. use_count() is a
+// relaxed read; the acquire fence orders it after the release done by whoever
+// dropped the other references, so their reads are finished before a write.
+template<typename T>
+inline bool exclusive(const std::shared_ptr<T> &p) {
+    if (p.use_count() != 1) return false;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return true;
+}
+
+// The object behind 'p', ready to be changed: copied first unless 'p' is its
+// only owner, created when 'p' is empty.
+template<typename T>
+inline T& own(std::shared_ptr<T> &p) {
+    if (!p) p = std::make_shared<T>();
+    else if (!exclusive(p)) p = std::make_shared<T>(*p);
+    return *p;
+}
+
+// Memory for the chunks and nodes one load builds. Allocations bump a pointer
+// through large blocks (std::pmr::monotonic_buffer_resource) under a spin
+// lock, so the pool tasks building a load can share it. Nothing is freed one
+// object at a time: the arena hands every block back when it is destroyed,
+// so whoever allocates from it must keep it alive as long as the objects and
+// any copy sharing them (Generation::backing does, in erp_menu.cpp).
+class Arena : public std::pmr::memory_resource {
+public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+private:
+    struct Hold {
+        std::atomic_flag &f;
+        explicit Hold(std::atomic_flag &flag) : f(flag) { while (f.test_and_set(std::memory_order_acquire)) {} }
+        ~Hold() { f.clear(std::memory_order_release); }
+    };
+    void* do_allocate(size_t bytes, size_t align) override {
+        Hold h(busy_);
+        return mem_.allocate(bytes, align);
+    }
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource &o) const noexcept override { return this == &o; }
+
+    std::pmr::monotonic_buffer_resource mem_;
+    std::atomic_flag busy_ = ATOMIC_FLAG_INIT;
+};
+
+// A column of T stored in chunks of CHUNK elements, with PAGE chunks to a
+// page. Copying a column copies its page table only, O(size / (CHUNK * PAGE)),
+// and every page and chunk stays shared with the copy until one side changes
+// it: set() and push_back() copy at most one page table and one chunk, so a
+// change costs O(CHUNK) whatever the column's size. Reads go through the page
+// and the chunk (two extra loads); scan() hands out whole chunk runs for loops
+// that want plain pointers. wrap() builds a column over elements that live
+// elsewhere (a mapped snapshot) without copying them: its chunks point into
+// that memory, and the first change to one copies just that chunk. New chunks
+// and pages come from the resource set with use() (an Arena while a load
+// builds the column), the heap otherwise; copies made by a change always come
+// from the heap.
+template<typename T>
+class Column {
+public:
+    static constexpr size_t CHUNK_BITS = 12, PAGE_BITS = 8;
+    static constexpr size_t CHUNK = size_t(1) << CHUNK_BITS, PAGE = size_t(1) << PAGE_BITS;
+
+    size_t size() const { return n_; }
+    bool empty() const { return n_ == 0; }
+    const T& operator[](size_t i) const {
+        return pages_[i >> (CHUNK_BITS + PAGE_BITS)]->chunk[(i >> CHUNK_BITS) & (PAGE - 1)]->at[i & (CHUNK - 1)];
+    }
+    const T& back() const { return (*this)[n_ - 1]; }
+
+    // where the chunks and pages created from now on are allocated (null: heap)
+    void use(std::pmr::memory_resource *mr) { mr_ = mr; }
+    std::pmr::memory_resource* resource() const { return mr_; }
+
+    void set(size_t i, const T &v) { writable(i >> CHUNK_BITS).data[i & (CHUNK - 1)] = v; }
+    void push_back(const T &v) {
+        writable(n_ >> CHUNK_BITS).push_back(v);
+        ++n_;
+    }
+    void pop_back() {
+        --n_;
+        size_t c = n_ >> CHUNK_BITS;
+        if (n_ & (CHUNK - 1)) writable(c).pop_back();
+        else own(pages_[c >> PAGE_BITS]).chunk[c & (PAGE - 1)].reset();
+        if (!(n_ & (CHUNK * PAGE - 1))) pages_.pop_back();
+    }
+    // append count elements from p, a chunk at a time
+    void append(const T *p, size_t count) {
+        while (count) {
+            size_t take = std::min(count, CHUNK - (n_ & (CHUNK - 1)));
+            writable(n_ >> CHUNK_BITS).append(p, take);
+            n_ += take;
+            p += take;
+            count -= take;
+        }
+    }
+    // Append o's elements: its chunks are shared when this column ends on a
+    // chunk boundary and allocates where o does, copied otherwise.
+    void append(const Column &o) {
+        if ((n_ & (CHUNK - 1)) || mr_ != o.mr_) {
+            o.scan(0, o.size(), [this](const T *p, size_t k) { append(p, k); });
+            return;
+        }
+        for (size_t c = 0; (c << CHUNK_BITS) < o.n_; ++c) {
+            size_t mine = n_ >> CHUNK_BITS, p = mine >> PAGE_BITS;
+            if (p == pages_.size()) pages_.push_back(make<Page>());
+            own(pages_[p]).chunk[mine & (PAGE - 1)] = o.pages_[c >> PAGE_BITS]->chunk[c & (PAGE - 1)];
+            n_ += std::min(CHUNK, o.n_ - (c << CHUNK_BITS));
+        }
+    }
+    void assign(const T *p, size_t count) { clear(); append(p, count); }
+    // The column of the count elements at p, which must stay valid and
+    // unchanged while this column or a copy of it can read them.
+    void wrap(const T *p, size_t count) {
+        clear();
+        for (size_t b = 0; b < count; b += CHUNK) {
+            if (!((b >> CHUNK_BITS) & (PAGE - 1))) pages_.push_back(make<Page>());
+            pages_.back()->chunk[(b >> CHUNK_BITS) & (PAGE - 1)] = make<Chunk>(p + b, std::min(CHUNK, count - b));
+        }
+        n_ = count;
+    }
+    void resize(size_t n, const T &v = T()) {
+        while (n_ > n) pop_back();
+        while (n_ < n) push_back(v);
+    }
+    void clear() { pages_.clear(); n_ = 0; }
+
+    // f(const T *p, size_t k) for the elements [b, e), one run per chunk
+    template<typename F>
+    void scan(size_t b, size_t e, F &&f) const {
+        while (b < e) {
+            size_t k = std::min(e - b, CHUNK - (b & (CHUNK - 1)));
+            f(&(*this)[b], k);
+            b += k;
+        }
+    }
+
+    class const_iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+        const_iterator() = default;
+        const_iterator(const Column *c, size_t i) : c_(c), i_(i) {}
+        reference operator*() const { return (*c_)[i_]; }
+        pointer operator->() const { return &(*c_)[i_]; }
+        reference operator[](difference_type k) const { return (*c_)[(size_t)((difference_type)i_ + k)]; }
+        const_iterator& operator++() { ++i_; return *this; }
+        const_iterator operator++(int) { const_iterator t = *this; ++i_; return t; }
+        const_iterator& operator--() { --i_; return *this; }
+        const_iterator operator--(int) { const_iterator t = *this; --i_; return t; }
+        const_iterator& operator+=(difference_type k) { i_ = (size_t)((difference_type)i_ + k); return *this; }
+        const_iterator& operator-=(difference_type k) { return *this += -k; }
+        const_iterator operator+(difference_type k) const { const_iterator t = *this; return t += k; }
+        const_iterator operator-(difference_type k) const { const_iterator t = *this; return t += -k; }
+        difference_type operator-(const const_iterator &o) const { return (difference_type)i_ - (difference_type)o.i_; }
+        bool operator==(const const_iterator &o) const { return i_ == o.i_; }
+        bool operator!=(const const_iterator &o) const { return i_ != o.i_; }
+        bool operator<(const const_iterator &o) const { return i_ < o.i_; }
+        bool operator>(const const_iterator &o) const { return i_ > o.i_; }
+        bool operator<=(const const_iterator &o) const { return i_ <= o.i_; }
+        bool operator>=(const const_iterator &o) const { return i_ >= o.i_; }
+    private:
+        const Column *c_ = nullptr;
+        size_t i_ = 0;
+    };
+    const_iterator begin() const { return { this, 0 }; }
+    const_iterator end() const { return { this, n_ }; }
+
+private:
+    // The elements of a chunk are at 'at': in 'data', which always has room
+    // for CHUNK so 'at' stays put while it fills up, or in wrapped memory
+    // (data empty). A copy always owns its elements, on the heap.
+    struct Chunk {
+        std::pmr::vector<T> data;
+        const T *at = nullptr;
+        size_t size = 0;
+        explicit Chunk(std::pmr::memory_resource *mr = nullptr) : data(mr ? mr : std::pmr::get_default_resource()) {
+            data.reserve(CHUNK);
+            at = data.data();
+        }
+        Chunk(const T *p, size_t k) : at(p), size(k) {} // wrapped
+        Chunk(const Chunk &o) : Chunk() { append(o.at, o.size); }
+        Chunk& operator=(const Chunk&) = delete;
+        bool owned() const { return at == data.data(); }
+        void push_back(const T &v) { data.push_back(v); ++size; }
+        void pop_back() { data.pop_back(); --size; }
+        void append(const T *p, size_t k) { data.insert(data.end(), p, p + k); size += k; }
+    };
+    struct Page { std::shared_ptr<Chunk> chunk[PAGE]; };
+
+    // a new page or chunk, from mr_ when set
+    template<typename X, typename... A>
+    std::shared_ptr<X> make(A&&... a) const {
+        if (!mr_) return std::make_shared<X>(std::forward<A>(a)...);
+        return std::allocate_shared<X>(std::pmr::polymorphic_allocator<X>(mr_), std::forward<A>(a)...);
+    }
+
+    // chunk c ready to be changed (created empty when c is the next one)
+    Chunk& writable(size_t c) {
+        size_t p = c >> PAGE_BITS;
+        if (p == pages_.size()) pages_.push_back(make<Page>());
+        std::shared_ptr<Chunk> &slot = own(pages_[p]).chunk[c & (PAGE - 1)];
+        if (!slot) slot = make<Chunk>(mr_);
+        else if (!slot->owned()) slot = std::make_shared<Chunk>(*slot);
+        return own(slot);
+    }
+
+    std::vector<std::shared_ptr<Page>> pages_;
+    size_t n_ = 0;
+    std::pmr::memory_resource *mr_ = nullptr;
+};
+
+} // namespace Cow
+
+#endif // COW_H
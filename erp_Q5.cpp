@@ -5,62 +5,55 @@
 //
 // Program:
 //  - Reads students_3000.csv
-//  - Builds unordered_map<string, vector<size_t>> index for students with grade >= 9.0 per course
-//  - Interactive prompt: query course code (e.g., OOPS or 110) -> returns matching students quickly
-//  - Demonstrates update of a student's grade and incremental maintenance of the index
+//  - Builds a per-course grade index: (grade, student) entries sorted by grade, highest first
+//  - Interactive prompt: query course code (e.g., OOPS or 110), optionally with a minimum grade
+//    or a grade range (OOPS 8, OOPS 7.5 8.5; default >= 9.0) -> binary search + contiguous slice
+//  - Registrar corrections at the same prompt (update ROLL COURSE GRADE, add ROLL COURSE GRADE,
+//    drop ROLL COURSE): the student's record changes and the course's postings get one
+//    O(log n) insert / erase, no rebuild
 
 #include <bits/stdc++.h>
+#include "fastcsv.h"
+#include "postings.h"
 using namespace std;
 
 struct Student {
-    string name;
-    string roll;
-    string branch;
+    string_view name;
+    string_view roll;
+    string_view branch;
     int start_year = 0;
-    vector<string> current_courses;
-    vector<pair<string,double>> prev_courses; // course_code | grade
+    vector<string_view> current_courses;
+    vector<pair<string_view,double>> prev_courses; // course_code | grade
 };
 
-static inline string trim(const string &s) {
-    size_t a = 0; while (a < s.size() && isspace((unsigned char)s[a])) ++a;
-    size_t b = s.size(); while (b > a && isspace((unsigned char)s[b-1])) --b;
-    return s.substr(a, b-a);
-}
+using FastCSV::trim;
 
-static inline vector<string> split_csv_line(const string &line, char delim=',') {
-    vector<string> out; string cur; bool inquotes=false;
-    for (size_t i=0;i<line.size();++i) {
-        char c=line[i];
-        if (c=='"') { inquotes = !inquotes; continue; }
-        if (c==delim && !inquotes) { out.push_back(cur); cur.clear(); }
-        else cur.push_back(c);
-    }
-    out.push_back(cur);
-    return out;
-}
+// Postings of one course (postings.h): {grade, student} sorted highest grade
+// first, then by student, so "grade >= x" is a prefix and "grade in [a, b]" a
+// contiguous slice, found in O(log n); a correction inserts or erases one
+// posting in O(log n) too. The grade travels with the posting, so a hit never
+// has to search the student's prev_courses again.
+using GradeList = Postings::List;
 
-static inline vector<string> parse_semis(const string &s) {
-    vector<string> out; string cur;
-    for (char c : s) {
-        if (c == ';') { out.push_back(trim(cur)); cur.clear(); }
-        else cur.push_back(c);
-    }
-    if (!cur.empty()) out.push_back(trim(cur));
+static const double HIGH_GRADE = 9.0; // default threshold
+
+static inline vector<string_view> parse_semis(string_view s) {
+    vector<string_view> out;
+    out.reserve(count(s.begin(), s.end(), ';') + 1);
+    FastCSV::for_each_semi(s, [&](string_view tok){ out.push_back(tok); });
     return out;
 }
 
-static inline vector<pair<string,double>> parse_prev(const string &s) {
-    vector<pair<string,double>> out;
-    auto parts = parse_semis(s);
-    for (auto &p : parts) {
-        auto pos = p.find('|');
-        if (pos == string::npos) continue;
-        string code = trim(p.substr(0,pos));
-        string gradeS = trim(p.substr(pos+1));
-        double g = 0.0;
-        try { g = stod(gradeS); } catch(...) { g = 0.0; }
+static FastCSV::ParseStats parse_stats; // junk grades / years (kept as 0)
+
+static inline vector<pair<string_view,double>> parse_prev(string_view s) {
+    vector<pair<string_view,double>> out;
+    out.reserve(count(s.begin(), s.end(), ';') + 1);
+    FastCSV::for_each_prev(s, [&](string_view code, string_view gradeS){
+        double g;
+        if (!FastCSV::parse_grade(gradeS, g)) ++parse_stats.bad_grades;
         out.emplace_back(code, g);
-    }
+    });
     return out;
 }
 
@@ -69,126 +62,159 @@ int main() {
     cin.tie(nullptr);
 
     const string csvfile = "students_3000.csv";
-    ifstream fin(csvfile);
-    if (!fin) {
+    FastCSV::MappedFile csv(csvfile); // backing memory for every Student field
+    FastCSV::Unquoted unquoted; // fields copied to drop inner quotes (must outlive 'students' too)
+    if (!csv.is_open()) {
         cerr << "ERROR: cannot open " << csvfile << ". Place it in working dir.\n";
         return 1;
     }
 
-    // read header
-    string header;
-    getline(fin, header);
+    string_view rest = csv.view(), line;
+    FastCSV::next_line(rest, line); // skip header
 
     vector<Student> students;
     students.reserve(3100);
-
-    string line;
-    while (getline(fin, line)) {
+    string_view cols[6];
+    while (FastCSV::next_line(rest, line)) {
         if (trim(line).empty()) continue;
-        auto cols = split_csv_line(line);
-        if (cols.size() < 6) continue;
+        if (FastCSV::split_fields(line, cols, 6, unquoted) < 6) continue; // skip malformed
         Student s;
-        string name = cols[0];
-        if (!name.empty() && name.front() == '"') name = name.substr(1);
-        if (!name.empty() && name.back() == '"') name.pop_back();
-        s.name = name;
-
-        string roll = cols[1];
-        if (!roll.empty() && roll.front() == '"') roll = roll.substr(1);
-        if (!roll.empty() && roll.back() == '"') roll.pop_back();
-        s.roll = trim(roll);
-
+        s.name = cols[0];
+        s.roll = trim(cols[1]);
         s.branch = trim(cols[2]);
-        try { s.start_year = stoi(trim(cols[3])); } catch(...) { s.start_year = 0; }
+        if (!FastCSV::parse_int(trim(cols[3]), s.start_year)) ++parse_stats.bad_years;
         s.current_courses = parse_semis(cols[4]);
         s.prev_courses = parse_prev(cols[5]);
         students.push_back(move(s));
     }
-    fin.close();
 
     cout << "Loaded " << students.size() << " students.\n";
+    if (parse_stats.rejected())
+        cout << "Rejected fields: " << parse_stats.bad_grades << " grade(s), " << parse_stats.bad_years << " start year(s).\n";
 
-    // Build index: course_key -> vector of student indices who got grade >= 9.0 in that course
-    unordered_map<string, vector<size_t>> high_grade_index;
-    high_grade_index.reserve(1024);
+    // Build index: course_key -> every {student, grade} posting of that course, best grade first
+    unordered_map<string_view, GradeList> grade_index; // keys point into the mapped CSV
+    grade_index.reserve(1024);
+    struct Posting { double grade; uint32_t student; };
+    unordered_map<string_view, vector<Posting>> unsorted;
+    unsorted.reserve(1024);
 
     for (size_t i = 0; i < students.size(); ++i) {
         const auto &prevs = students[i].prev_courses;
         for (const auto &pg : prevs) {
-            // normalize key by trimming; If course identifiers can be numeric, the CSV uses numeric tokens,
+            // key is already trimmed by the parser; If course identifiers can be numeric, the CSV uses numeric tokens,
             // we keep the string representation (so "110" and 110 map to "110").
-            string key = trim(pg.first);
-            if (pg.second >= 9.0) {
-                high_grade_index[key].push_back(i);
-            }
+            string_view key = pg.first;
+            if (!isnan(pg.second)) unsorted[key].push_back({pg.second, (uint32_t)i});
         }
     }
+    for (auto &kv : unsorted) {
+        vector<Posting> &p = kv.second;
+        sort(p.begin(), p.end(), [](const Posting &a, const Posting &b) { return Postings::before(a.grade, a.student, b.grade, b.student); });
+        vector<double> g(p.size());
+        vector<uint32_t> s(p.size());
+        for (size_t k = 0; k < p.size(); ++k) { g[k] = p[k].grade; s[k] = p[k].student; }
+        grade_index[kv.first] = GradeList::build(g.data(), s.data(), p.size());
+    }
+    unsorted.clear();
 
     // Show a few sample index sizes
-    cout << "Built index. Sample entries (course -> count):\n";
+    cout << "Built index. Sample entries (course -> count with grade >= 9.0):\n";
     int sample = 0;
-    for (auto &kv : high_grade_index) {
-        cout << "  " << kv.first << " -> " << kv.second.size() << "\n";
+    for (auto &kv : grade_index) {
+        auto r = kv.second.range(HIGH_GRADE, numeric_limits<double>::infinity());
+        cout << "  " << kv.first << " -> " << (r.second - r.first) << "\n";
         if (++sample >= 8) break;
     }
     cout << "Use the interactive prompt to query a course (type 'exit' to quit).\n";
+    cout << "Corrections: update ROLL COURSE GRADE | add ROLL COURSE GRADE | drop ROLL COURSE\n";
+
+    // Registrar corrections apply to the student's last attempt at the course
+    // (add records a new one); the course's postings are patched in place.
+    unordered_map<string_view, size_t> by_roll; // roll -> first student with it
+    for (size_t i = 0; i < students.size(); ++i) by_roll.emplace(students[i].roll, i);
+    deque<string> typed_courses; // text of course ids first seen at the prompt (index keys point here)
+    auto edit = [&](const vector<string> &w) {
+        bool with_grade = w[0] != "drop";
+        double g = 0;
+        if (w.size() != (with_grade ? 4u : 3u) || (with_grade && !FastCSV::parse_grade(w[3], g))) {
+            cout << "Expected: update ROLL COURSE GRADE | add ROLL COURSE GRADE | drop ROLL COURSE\n";
+            return;
+        }
+        auto who = by_roll.find(w[1]);
+        if (who == by_roll.end()) { cout << "No student with roll '" << w[1] << "'.\n"; return; }
+        size_t i = who->second;
+        auto &prevs = students[i].prev_courses;
+        auto last = find_if(prevs.rbegin(), prevs.rend(), [&](const pair<string_view,double> &pg) { return pg.first == w[2]; });
+        if (w[0] == "add") {
+            auto known = grade_index.find(w[2]);
+            string_view key = known != grade_index.end() ? known->first : string_view(typed_courses.emplace_back(w[2]));
+            prevs.emplace_back(key, g);
+            if (!isnan(g)) grade_index[key].insert(g, (uint32_t)i);
+        } else if (last == prevs.rend()) {
+            cout << "No grade for '" << w[2] << "' on record for " << w[1] << ".\n";
+            return;
+        } else {
+            GradeList &list = grade_index[last->first];
+            list.erase(last->second, (uint32_t)i);
+            if (w[0] == "update") { last->second = g; if (!isnan(g)) list.insert(g, (uint32_t)i); }
+            else prevs.erase(next(last).base());
+        }
+        cout << "Done. " << students[i].name << " | roll: " << students[i].roll << " | previous:";
+        for (const auto &pg : prevs) cout << " " << pg.first << "|" << pg.second;
+        cout << "\n";
+    };
 
     // Interactive prompt
     while (true) {
-        cout << "\nEnter course id to query (e.g. OOPS or 110) > ";
+        cout << "\nEnter course id to query, optionally with a grade or range (e.g. OOPS, 110 8, OOPS 7.5 8.5) > ";
         string q;
-        if (! (cin >> q) ) break;
-        if (q == "exit" || q == "quit") break;
-        // Normalize
-        string key = trim(q);
-
-        auto it = high_grade_index.find(key);
-        if (it == high_grade_index.end() || it->second.empty()) {
-            cout << "No students found with grade >= 9.0 in course '" << key << "'.\n";
+        if (!getline(cin >> ws, q)) break;
+        istringstream in(q);
+        vector<string> words;
+        for (string w; in >> w; ) words.push_back(w);
+        if (words.empty()) continue;
+        if (words[0] == "exit" || words[0] == "quit") break;
+        if (words[0] == "update" || words[0] == "add" || words[0] == "drop") { edit(words); continue; }
+        // trailing numbers are the grade bounds
+        double bound[2];
+        size_t nums = 0;
+        while (nums < 2 && words.size() > 1 && FastCSV::parse_grade(words.back(), bound[1 - nums])) { words.pop_back(); ++nums; }
+        double lo = HIGH_GRADE, hi = numeric_limits<double>::infinity();
+        if (nums == 1) lo = bound[1];
+        if (nums == 2) { lo = min(bound[0], bound[1]); hi = max(bound[0], bound[1]); }
+        string course = words[0];
+        for (size_t w = 1; w < words.size(); ++w) course += " " + words[w];
+        string_view key = trim(course);
+        auto text = [](double g) { // 9.0, 7.5, 8.25
+            ostringstream os;
+            if (round(g * 10) == g * 10) os << fixed << setprecision(1);
+            os << g;
+            return os.str();
+        };
+        string range = nums == 2 ? "in [" + text(lo) + ", " + text(hi) + "]" : ">= " + text(lo);
+
+        static const GradeList no_grades;
+        auto it = grade_index.find(key);
+        auto r = (it == grade_index.end() ? no_grades : it->second).range(lo, hi);
+        size_t found = r.second - r.first;
+        if (!found) {
+            cout << "No students found with grade " << range << " in course '" << key << "'.\n";
             continue;
         }
-        const auto &vec = it->second;
-        cout << "Found " << vec.size() << " student(s) with grade >= 9.0 in '" << key << "'.\n";
-        // Print up to first 30 matches
-        size_t to_show = min<size_t>(vec.size(), 30);
-        for (size_t k = 0; k < to_show; ++k) {
-            const Student &s = students[vec[k]];
-            // Show name, roll, branch, start, and the grade for that course
-            double grade_for_course = -1.0;
-            for (const auto &pg : s.prev_courses) if (trim(pg.first) == key) { grade_for_course = pg.second; break; }
-            cout << setw(3) << k+1 << ". " << s.name << " | roll: " << s.roll
+        cout << "Found " << found << " student(s) with grade " << range << " in '" << key << "'.\n";
+        // Print up to first 30 matches, highest grade first
+        size_t to_show = min<size_t>(found, 30);
+        size_t k = 0;
+        it->second.for_each(r.first, r.first + to_show, [&](double grade, uint32_t idx) {
+            const Student &s = students[idx];
+            cout << setw(3) << ++k << ". " << s.name << " | roll: " << s.roll
                  << " | branch: " << s.branch << " | start: " << s.start_year
-                 << " | grade: " << (grade_for_course >= 0 ? to_string(grade_for_course) : "N/A") << "\n";
-        }
-        if (vec.size() > to_show) cout << "  ... and " << (vec.size() - to_show) << " more\n";
+                 << " | grade: " << to_string(grade) << "\n";
+        });
+        if (found > to_show) cout << "  ... and " << (found - to_show) << " more\n";
     }
 
-    // Demonstrate incremental update: change a student's grade for a course and update index
-    // (This block is illustrative and won't run unless you want to run it manually;
-    //  you can remove or adapt it for your system integration.)
-    //
-    // Example: update student 0's grade in course "OOPS" to 9.5 (and add to index if needed)
-    //
-    // string upd_course = "OOPS";
-    // size_t stu_idx = 0;
-    // double new_grade = 9.5;
-    // // search prev_courses vector for the course and update grade; if not present, add it
-    // bool found = false;
-    // for (auto &pg : students[stu_idx].prev_courses) {
-    //     if (trim(pg.first) == upd_course) { pg.second = new_grade; found = true; break; }
-    // }
-    // if (!found) students[stu_idx].prev_courses.emplace_back(upd_course, new_grade);
-    // // Now update index:
-    // if (new_grade >= 9.0) {
-    //     auto &list = high_grade_index[upd_course];
-    //     // add stu_idx if not already present
-    //     if (find(list.begin(), list.end(), stu_idx) == list.end()) list.push_back(stu_idx);
-    // } else {
-    //     // if student's new grade fell below threshold, remove from index
-    //     auto &list = high_grade_index[upd_course];
-    //     list.erase(remove(list.begin(), list.end(), stu_idx), list.end());
-    // }
-
     cout << "Exiting.\n";
     return 0;
 }
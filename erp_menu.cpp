@@ -4,16 +4,39 @@
 //   g++ -std=c++17 erp_menu.cpp -O2 -o erp_menu
 // Or use Makefile with THREAD=std or THREAD=pthread to enable real threads.
 //
+// Options:
+//   --csv FILE         dataset to load instead of students_3000.csv (e.g. from gen_students)
+//   --load-workers N   parse the CSV with N workers (default: online CPUs in threaded builds)
+//   --sample-sort      Q3 partitions rows with sampled splitters instead of radix sort / merge
+//   --sort-memory MB   Q3 sorts the CSV out of core (spilled runs + merge) within MB megabytes
+//   --sort SPEC        Q3/Q4 sort order, e.g. "start_year desc, avg_grade desc, name" (also menu option 9)
+//
+// Menu option 11 corrects, adds or drops course grades (a ';'-separated batch);
+// each edit updates the grade index in O(log n) and the Q5 bitmaps in place, and
+// cached sort orders re-place the edited rows when next read (O(n) once per read).
+//
+// Reloads, appends (options 6/8) and edits publish a new immutable generation of
+// the data with one atomic swap; each action reads the generation it started
+// with. Threaded builds can keep following the CSV in the background (option 8).
+//
 // Exports (when chosen):
 //   - students_sorted_q3.csv
 //   - students_sorted_menu.csv
 //   - high_grade_students.csv
 //   - q2_mapped_samples.csv (optional export from Q2)
 //
-// Requires students_3000.csv in current directory.
+// Requires students_3000.csv in current directory. A binary snapshot of the parsed
+// data (students_3000.snap, menu option 7) is used instead when it is up to date.
 
 #include <bits/stdc++.h>
 #include "mythread_noos.h"
+#include "fastcsv.h"
+#include "workpool.h"
+#include "roaring.h"
+#include "cow.h"
+#include "postings.h"
+#include <poll.h>
+#include <sys/inotify.h>
 using namespace std;
 using Clock = chrono::high_resolution_clock;
 using ms = chrono::duration<double, milli>;
@@ -22,26 +45,23 @@ using ms = chrono::duration<double, milli>;
 #if defined(USE_STD_THREAD)
   #include <thread>
   #include <mutex>
-  struct ThreadWrapper { using Task = function<void()>; std::thread thr; bool started=false;
-    template<typename F> void start(F&& f){ thr = std::thread(std::forward<F>(f)); started=true; }
-    void join(){ if(started && thr.joinable()) thr.join(); started=false; }
-  };
   using MutexWrapper = std::mutex;
   struct LockGuard { explicit LockGuard(MutexWrapper &m):mref(m){ mref.lock(); } ~LockGuard(){ mref.unlock(); } MutexWrapper &mref; };
 #elif defined(USE_POSIX)
   #include <pthread.h>
   struct MutexWrapper { pthread_mutex_t m; MutexWrapper(){ pthread_mutex_init(&m,nullptr);} ~MutexWrapper(){ pthread_mutex_destroy(&m);} void lock(){ pthread_mutex_lock(&m);} void unlock(){ pthread_mutex_unlock(&m);} };
   struct LockGuard { explicit LockGuard(MutexWrapper &m):mref(m){ mref.lock(); } ~LockGuard(){ mref.unlock(); } MutexWrapper &mref; };
+#endif
+#if defined(USE_STD_THREAD) || defined(USE_POSIX)
+  // start() forks the task into the shared work-stealing pool (workpool.h) and
+  // join() waits for it, running other queued tasks meanwhile; no OS thread is
+  // created per call. An exception thrown by the task is rethrown by join().
   struct ThreadWrapper {
     using Task = function<void()>;
-    pthread_t thr; bool started=false;
-    template<typename F> void start(F&& f){
-      auto fn = new Task(std::forward<F>(f));
-      if (pthread_create(&thr,nullptr, &ThreadWrapper::entry, fn)!=0){ delete fn; throw runtime_error("pthread_create failed"); }
-      started = true;
-    }
-    void join(){ if(started){ pthread_join(thr,nullptr); started=false; } }
-    static void* entry(void* arg){ Task* t = static_cast<Task*>(arg); try{ (*t)(); }catch(...){ } delete t; return nullptr; }
+    WorkPool::JobPtr job;
+    template<typename F> void start(F&& f){ job = WorkPool::Pool::instance().fork(Task(std::forward<F>(f))); }
+    void join(){ if(job){ auto j = std::move(job); job = nullptr; WorkPool::Pool::instance().join(j); } }
+    ~ThreadWrapper(){ if(job){ try{ join(); }catch(...){ } } }
   };
 #else
   // fallback: no-OS threads (synchronous)
@@ -50,134 +70,1935 @@ using ms = chrono::duration<double, milli>;
   struct ThreadWrapper { template<typename F> void start(F&& f){ MyThreadNoOS::Thread t(std::forward<F>(f)); (void)t; } void join(){} };
 #endif
 
-// ---------------- Student struct ----------------
-struct Student {
-    string name;
-    string roll;
-    string branch;
-    int start_year = 0;
-    vector<string> current_courses;           // semicolon-separated tokens parsed into vector
-    vector<pair<string,double>> prev_courses; // each pair is (course_code, grade)
-};
+// ---------------- Fork/join helpers ----------------
+// Number of pool workers (1 in the synchronous fallback build).
+static size_t pool_size() {
+#if defined(USE_STD_THREAD) || defined(USE_POSIX)
+    return WorkPool::Pool::instance().size();
+#else
+    return 1;
+#endif
+}
 
-// ---------------- CSV helpers ----------------
-static inline string trim(const string &s) {
-    size_t a = 0;
-    while (a < s.size() && isspace((unsigned char)s[a])) ++a;
-    size_t b = s.size();
-    while (b > a && isspace((unsigned char)s[b-1])) --b;
-    return s.substr(a, b-a);
+// How many parts to cut n items into so that each part gets at least
+// min_per_part items and no more parts than pool workers exist.
+static size_t fork_parts(size_t n, size_t min_per_part) {
+    return max<size_t>(1, min(pool_size(), n / max<size_t>(1, min_per_part)));
 }
 
-static inline vector<string> split_csv_line(const string &line, char delim=',') {
-    vector<string> out; string cur; bool inquotes=false;
-    for (size_t i=0;i<line.size();++i) {
-        char c = line[i];
-        if (c == '"') { inquotes = !inquotes; continue; }
-        if (c == delim && !inquotes) { out.push_back(cur); cur.clear(); }
-        else cur.push_back(c);
+// Run f(p) for every p in [0, parts) as pool tasks and wait. Part 0 runs on
+// the calling thread. Worker p adds its busy time to (*worker_times_ms)[p].
+template<typename F>
+static void run_parts(size_t parts, F f, vector<double> *worker_times_ms) {
+    auto timed = [&f, worker_times_ms](size_t p) {
+        auto t0 = Clock::now();
+        f(p);
+        if (worker_times_ms) (*worker_times_ms)[p] += chrono::duration_cast<ms>(Clock::now() - t0).count();
+    };
+    if (parts == 1) { timed(0); return; }
+    vector<unique_ptr<ThreadWrapper>> th(parts);
+    for (size_t p = 1; p < parts; ++p) {
+        th[p] = make_unique<ThreadWrapper>();
+        th[p]->start([&timed, p](){ timed(p); });
     }
-    out.push_back(cur);
-    return out;
+    timed(0);
+    for (size_t p = 1; p < parts; ++p) th[p]->join();
 }
 
-static inline vector<string> parse_semis(const string &s) {
-    vector<string> out; string cur;
-    for (char c : s) {
-        if (c == ';') { out.push_back(trim(cur)); cur.clear(); }
-        else cur.push_back(c);
+// Write rows [0, n) to 'out' in order. row(os, i) formats row i; blocks of
+// rows are formatted by pool tasks into their own buffers and written in order.
+static const size_t MIN_ROWS_PER_EXPORT_WORKER = 1 << 14;
+template<typename F>
+static void export_rows(ostream &out, size_t n, F row) {
+    size_t parts = fork_parts(n, MIN_ROWS_PER_EXPORT_WORKER);
+    vector<string> text(parts);
+    run_parts(parts, [&](size_t p) {
+        ostringstream os;
+        os.copyfmt(out);
+        for (size_t i = (n * p) / parts; i < (n * (p + 1)) / parts; ++i) row(os, i);
+        text[p] = std::move(os).str();
+    }, nullptr);
+    for (auto &t : text) out.write(t.data(), (streamsize)t.size());
+}
+
+// ---------------- Student store (struct of arrays) ----------------
+// One contiguous column per field instead of one heap object per student, so
+// the comparator, the index build and the exports stream through memory.
+// Course lists are CSR: the current courses of student i are
+// cur_course[cur_off[i] .. cur_off[i+1]), and the previous ones (with grades)
+// prev_course / prev_grade[prev_off[i] .. prev_off[i] + prev_len[i]). Rows are
+// stored back to back in row order until a registrar edit (add_prev_to /
+// drop_prev_at) moves a row to the end of the columns; the slots it leaves
+// behind are dead until the next reload or snapshot. Courses and branches
+// are stored as dictionary ids. Text columns are views into the mapped CSV or
+// snapshot (kept alive by Generation::backing below); nothing is copied out of the file
+// while loading. Every column is a Cow::Column (cow.h): a copied store shares
+// all of its chunks with the original, and a change copies only the chunks it
+// touches, so generations built from one another share what they did not change.
+template<typename T>
+struct Span {
+    const Cow::Column<T> *col = nullptr;
+    size_t b = 0, e = 0;
+    typename Cow::Column<T>::const_iterator begin() const { return col->begin() + (ptrdiff_t)b; }
+    typename Cow::Column<T>::const_iterator end() const { return col->begin() + (ptrdiff_t)e; }
+    size_t size() const { return e - b; }
+    bool empty() const { return b == e; }
+    const T& operator[](size_t i) const { return (*col)[b + i]; }
+};
+
+// RollNumber-style detection (see erp_q1.cpp): an all-digit roll of up to 18
+// digits is stored as its value, anything else as ROLL_NOT_NUMERIC. Two numeric
+// rolls of the same length then compare as integers in the same order as text.
+static const uint64_t ROLL_NOT_NUMERIC = ~0ULL;
+static uint64_t encode_roll(string_view r) {
+    if (r.empty() || r.size() > 18) return ROLL_NOT_NUMERIC;
+    uint64_t v = 0;
+    for (char c : r) {
+        if (c < '0' || c > '9') return ROLL_NOT_NUMERIC;
+        v = v * 10 + (uint64_t)(c - '0');
     }
-    if (!cur.empty()) out.push_back(trim(cur));
-    return out;
+    return v;
 }
 
-static inline vector<pair<string,double>> parse_prev(const string &s) {
-    vector<pair<string,double>> out; auto parts = parse_semis(s);
-    for (auto &p : parts) {
-        auto pos = p.find('|');
-        if (pos == string::npos) continue;
-        string code = trim(p.substr(0,pos));
-        string gradeS = trim(p.substr(pos+1));
-        double g = 0.0;
-        try { g = stod(gradeS); } catch(...) { g = 0.0; }
-        out.emplace_back(code, g);
+// Interning dictionary: every distinct course code / branch gets a dense id
+// (0, 1, 2, ...) the first time it is seen, so the store, the index and the
+// Q2 mapping tables handle small integers instead of hashing text.
+static const uint32_t NO_ID = ~0u;
+struct Dictionary {
+    vector<string_view> names; // id -> text (views into the mapped file)
+    unordered_map<string_view, uint32_t> ids;
+
+    size_t size() const { return names.size(); }
+    string_view operator[](uint32_t id) const { return names[id]; }
+    uint32_t find(string_view s) const {
+        auto it = ids.find(s);
+        return it == ids.end() ? NO_ID : it->second;
+    }
+    uint32_t intern(string_view s) {
+        auto it = ids.find(s);
+        if (it != ids.end()) return it->second;
+        uint32_t id = (uint32_t)names.size();
+        names.push_back(s);
+        ids.emplace(s, id);
+        return id;
+    }
+};
+
+struct StudentStore {
+    Cow::Column<string_view> name;
+    Cow::Column<string_view> roll;
+    Cow::Column<uint64_t> roll_code;     // encode_roll(roll)
+    Cow::Column<uint32_t> branch_id;     // id in 'branches'
+    Cow::Column<int32_t> start_year;
+    Cow::Column<uint32_t> cur_off;       // size() + 1 entries (may be empty while size() == 0)
+    Cow::Column<uint32_t> cur_course;    // ids in 'courses'
+    Cow::Column<uint32_t> prev_off;      // size() + 1 entries (may be empty while size() == 0); the last one is the next free slot
+    Cow::Column<uint32_t> prev_len;      // size() entries
+    Cow::Column<uint32_t> prev_course;   // ids in 'courses'
+    Cow::Column<double> prev_grade;
+    Dictionary branches;
+    Dictionary courses;
+    vector<uint32_t> branch_rank;        // branch id -> position in name order
+
+    size_t size() const { return start_year.size(); }
+    bool empty() const { return start_year.empty(); }
+    void clear() { *this = StudentStore(); }
+
+    // allocate the chunks the columns create from now on from 'mr' (null: the heap)
+    void use(std::pmr::memory_resource *mr) {
+        name.use(mr); roll.use(mr); roll_code.use(mr); branch_id.use(mr); start_year.use(mr);
+        cur_off.use(mr); cur_course.use(mr); prev_off.use(mr); prev_len.use(mr); prev_course.use(mr); prev_grade.use(mr);
+    }
+
+    string_view branch(size_t i) const { return branches[branch_id[i]]; }
+    string_view course(uint32_t id) const { return courses[id]; }
+    Span<uint32_t> current(size_t i) const { return { &cur_course, cur_off[i], cur_off[i+1] }; }
+    size_t prev_begin(size_t i) const { return prev_off[i]; }
+    size_t prev_end(size_t i) const { return prev_off[i] + prev_len[i]; }
+
+    // A new branch is rare (a handful per dataset), so the rank table is simply
+    // rebuilt; comparing two branches is then one integer compare.
+    uint32_t intern_branch(string_view b) {
+        size_t before = branches.size();
+        uint32_t id = branches.intern(b);
+        if (branches.size() != before) {
+            vector<uint32_t> by_name(branches.size());
+            iota(by_name.begin(), by_name.end(), 0u);
+            sort(by_name.begin(), by_name.end(), [&](uint32_t x, uint32_t y){ return branches[x] < branches[y]; });
+            branch_rank.assign(by_name.size(), 0);
+            for (uint32_t r = 0; r < by_name.size(); ++r) branch_rank[by_name[r]] = r;
+        }
+        return id;
+    }
+
+    // leading 0 of the offset columns, added with the first row
+    void open_offsets() {
+        if (cur_off.empty()) { cur_off.push_back(0); prev_off.push_back(0); }
     }
-    return out;
+
+    // Row building: begin_row(), then any add_current()/add_prev(), then end_row().
+    void begin_row(string_view nm, string_view rl, string_view br, int year) {
+        open_offsets();
+        name.push_back(nm);
+        roll.push_back(rl);
+        roll_code.push_back(encode_roll(rl));
+        branch_id.push_back(intern_branch(br));
+        start_year.push_back(year);
+    }
+    void add_current(string_view code) { cur_course.push_back(courses.intern(code)); }
+    void add_prev(string_view code, double grade) { prev_course.push_back(courses.intern(code)); prev_grade.push_back(grade); }
+    void end_row() {
+        cur_off.push_back((uint32_t)cur_course.size());
+        prev_len.push_back((uint32_t)prev_course.size() - prev_off.back());
+        prev_off.push_back((uint32_t)prev_course.size());
+    }
+
+    // true while every row's previous courses end where the next row's begin
+    // (no registrar edit has moved or shrunk a row), i.e. prev_off is plain CSR
+    bool prev_packed() const {
+        for (size_t i = 0; i < size(); ++i) if (prev_off[i] + prev_len[i] != prev_off[i+1]) return false;
+        return true;
+    }
+
+    // Registrar edits of row i's previous courses. A row grows in place only
+    // when it ends at the end of the columns; otherwise it is copied there
+    // first, so an add costs O(row length) and never shifts other rows.
+    void add_prev_to(size_t i, uint32_t course, double grade) {
+        if (prev_end(i) != prev_course.size()) {
+            size_t b = prev_begin(i), len = prev_len[i];
+            prev_off.set(i, (uint32_t)prev_course.size());
+            for (size_t k = b; k < b + len; ++k) {
+                uint32_t c = prev_course[k];
+                double g = prev_grade[k];
+                prev_course.push_back(c);
+                prev_grade.push_back(g);
+            }
+        }
+        prev_course.push_back(course);
+        prev_grade.push_back(grade);
+        prev_len.set(i, prev_len[i] + 1);
+        prev_off.set(size(), (uint32_t)prev_course.size()); // rows added later start after it
+    }
+    // Remove slot k of row i, keeping the order of the others.
+    void drop_prev_at(size_t i, size_t k) {
+        size_t e = prev_end(i);
+        for (; k + 1 < e; ++k) { prev_course.set(k, prev_course[k+1]); prev_grade.set(k, prev_grade[k+1]); }
+        prev_len.set(i, prev_len[i] - 1);
+        if (e == prev_course.size()) {
+            prev_course.pop_back();
+            prev_grade.pop_back();
+            prev_off.set(size(), (uint32_t)prev_course.size());
+        }
+    }
+
+    // Move every row of 'o' to the end of this store (used to stitch the
+    // per-worker parse results together in file order). Ids of 'o' are
+    // translated into this store's dictionaries; the rows are copied into this
+    // store's chunks unless it is empty and allocates where 'o' does.
+    void append(StudentStore &&o) {
+        if (o.empty()) return;
+        if (empty() && branches.size() == 0 && courses.size() == 0 && name.resource() == o.name.resource()) { *this = move(o); return; }
+        open_offsets();
+        vector<uint32_t> bmap(o.branches.size()), cmap(o.courses.size());
+        for (uint32_t b = 0; b < bmap.size(); ++b) bmap[b] = intern_branch(o.branches[b]);
+        for (uint32_t c = 0; c < cmap.size(); ++c) cmap[c] = courses.intern(o.courses[c]);
+        name.append(o.name);
+        roll.append(o.roll);
+        roll_code.append(o.roll_code);
+        for (uint32_t b : o.branch_id) branch_id.push_back(bmap[b]);
+        start_year.append(o.start_year);
+        uint32_t cbase = (uint32_t)cur_course.size(), pbase = (uint32_t)prev_course.size();
+        for (size_t i = 1; i < o.cur_off.size(); ++i) cur_off.push_back(cbase + o.cur_off[i]);
+        for (size_t i = 1; i < o.prev_off.size(); ++i) prev_off.push_back(pbase + o.prev_off[i]);
+        prev_len.append(o.prev_len);
+        for (uint32_t c : o.cur_course) cur_course.push_back(cmap[c]);
+        for (uint32_t c : o.prev_course) prev_course.push_back(cmap[c]);
+        prev_grade.append(o.prev_grade);
+        o.clear();
+    }
+
+    // Rows [b, e) of 'o' as a store of their own, with o's dictionaries and
+    // every row's previous courses packed again (external sort runs).
+    static StudentStore slice(const StudentStore &o, size_t b, size_t e) {
+        StudentStore s;
+        s.branches = o.branches;
+        s.courses = o.courses;
+        s.branch_rank = o.branch_rank;
+        for (size_t i = b; i < e; ++i) {
+            s.open_offsets();
+            s.name.push_back(o.name[i]);
+            s.roll.push_back(o.roll[i]);
+            s.roll_code.push_back(o.roll_code[i]);
+            s.branch_id.push_back(o.branch_id[i]);
+            s.start_year.push_back(o.start_year[i]);
+            for (uint32_t c : o.current(i)) s.cur_course.push_back(c);
+            for (size_t k = o.prev_begin(i); k < o.prev_end(i); ++k) {
+                s.prev_course.push_back(o.prev_course[k]);
+                s.prev_grade.push_back(o.prev_grade[k]);
+            }
+            s.end_row();
+        }
+        return s;
+    }
+};
+
+// ---------------- CSV helpers ----------------
+// Tokenizing lives in fastcsv.h and only produces string_views, which are
+// pushed straight into the store columns (course codes and branches through
+// the store's dictionaries).
+using FastCSV::trim;
+
+// ---------------- Data generations ----------------
+// Per-course grade index: every graded attempt of course c as a posting
+// {grade, student}, highest grade first and ascending student id among equal
+// grades, in a Postings::List (postings.h). "grade >= x" is then a prefix and
+// "grade in [a, b]" a contiguous slice of the list, both found by one
+// root-to-leaf descent (grade_range()), so any threshold costs O(log n), and a
+// registrar edit inserts or erases one posting in O(log n) as well. Postings
+// carry their grade, so queries and exports never go back to the students'
+// course lists. Copies of a list share its nodes until one of them changes.
+using Postings::List;
+static bool grade_before(double ga, uint32_t sa, double gb, uint32_t sb) { return Postings::before(ga, sa, gb, sb); }
+// The same postings as sets of students per course and whole-grade bucket
+// (bucket b holds grades in [b, b+1); 0 also takes anything lower, 10 anything
+// higher), as compressed bitmaps for multi-course AND / OR / NOT queries.
+static const size_t GRADE_BUCKETS = 11;
+static size_t grade_bucket(double g) { return g >= 1 ? (size_t)min(g, (double)(GRADE_BUCKETS - 1)) : 0; } // clamped before the cast
+static const double HIGH_GRADE = 9.0; // default Q5 threshold
+
+// The bucket bitmaps of one course, shared between generations: edit() copies
+// them (11 bitmaps, whose containers stay shared) only while another
+// generation still uses them.
+using GradeBuckets = array<Roaring::Bitmap, GRADE_BUCKETS>;
+struct CourseBitmaps {
+    shared_ptr<GradeBuckets> buckets; // null: no postings yet
+    const Roaring::Bitmap& operator[](size_t b) const {
+        static const GradeBuckets none{};
+        return buckets ? (*buckets)[b] : none[b];
+    }
+    GradeBuckets& edit() { return Cow::own(buckets); }
+};
+
+// Memory the string_views of a generation point into (mapped CSV or snapshot,
+// appended ranges, unquoted fields, course codes typed at the menu). It is a
+// singly linked list shared by copies, so adding to it is O(1) however much a
+// generation has kept; it is freed iteratively, however long it grew.
+class Backing {
+public:
+    Backing() = default;
+    Backing(const Backing&) = default;
+    Backing& operator=(const Backing&) = default;
+    ~Backing() {
+        while (head_ && Cow::exclusive(head_)) {
+            shared_ptr<const Node> next = head_->next;
+            head_ = move(next);
+        }
+    }
+    void push_back(shared_ptr<const void> p) { head_ = make_shared<const Node>(Node{ move(p), move(head_) }); }
+private:
+    struct Node {
+        shared_ptr<const void> item;
+        shared_ptr<const Node> next;
+    };
+    shared_ptr<const Node> head_;
+};
+
+// Everything one load produced (the store, the grade index and bitmaps, and
+// the files their string_views point into) is one Generation, and a published
+// generation is never modified again (RCU style):
+//   - readers take current_generation() once per menu action and hold that
+//     shared_ptr to the end of it, so a reload, append or edit published in
+//     the meantime can never show them a half-built store or index;
+//   - writers (loads, appends, registrar edits) build the next generation off
+//     to the side, from scratch or as a copy of the current one, and publish()
+//     it with one atomic pointer swap. Writers are serialized by index_mtx;
+//     readers never take a lock.
+// A generation built from another one (an append or an edit batch) shares
+// everything it did not change with it: the store's column chunks, the
+// postings' tree nodes, each course's bitmaps and the backing memory. Whatever
+// a replaced generation used alone is freed by whoever drops the last
+// reference to it.
+// The column chunks and postings nodes a full load builds come from one
+// Cow::Arena, kept in the load's backing: every generation descending from it
+// shares that backing, so the last one still sharing its chunks and nodes
+// keeps the arena, and dropping that generation frees the load in a few large
+// blocks instead of one chunk and node at a time. Appends and edits allocate
+// what they add or copy from the heap, so a long edit session does not grow
+// the arena.
+struct Generation {
+    uint64_t load = 0;  // full load it descends from (appends and edits keep it)
+    uint64_t edits = 0; // registrar edits applied since that load
+    bool from_snapshot = false;
+    Backing backing;    // memory behind the string_views in 'students' (and the load's arena)
+    Cow::Arena *arena = nullptr; // in 'backing'; set while the load builds this generation, null in copies
+    StudentStore students;
+    vector<List> grade_index;            // course id -> postings, grade desc
+    vector<CourseBitmaps> grade_bitmaps; // course id -> bucket -> students
+    FastCSV::ParseStats load_stats; // rejected fields of the load and the appends since
+};
+using GenerationPtr = shared_ptr<const Generation>;
+
+static MutexWrapper index_mtx; // held by writers from reading the current generation to publishing the next
+static GenerationPtr live_generation = make_shared<const Generation>(); // only via current_generation() / publish()
+static uint64_t loads = 0; // last load id handed out (writers only)
+
+static GenerationPtr current_generation() { return atomic_load(&live_generation); }
+static void publish(GenerationPtr g) { atomic_store(&live_generation, move(g)); }
+
+// An empty generation for a full load, building into a fresh arena.
+static shared_ptr<Generation> new_generation() {
+    auto g = make_shared<Generation>();
+    g->load = ++loads;
+    auto arena = make_shared<Cow::Arena>();
+    g->arena = arena.get();
+    g->backing.push_back(move(arena));
+    g->students.use(g->arena);
+    return g;
 }
 
-// ---------------- Global canonical storage / index ----------------
-static vector<Student> students; // canonical store
-static unordered_map<string, vector<size_t>> high_grade_index; // course -> list of student indices with grade>=9
-static MutexWrapper index_mtx;
+// The next generation as a copy of 'g' (appends, edits). The copy shares all
+// of g's data, so it costs O(courses + pages of the columns): the page tables
+// of the store columns (Cow::Column, 2^20 entries a page), the dictionaries,
+// one postings root and one bitmap pointer per course. Nothing is parsed or
+// sorted again; the appends and edits applied to the copy then pay for the
+// chunks and nodes they change, from the heap.
+static shared_ptr<Generation> copy_generation(const Generation &g) {
+    auto c = make_shared<Generation>(g);
+    c->arena = nullptr;
+    c->students.use(nullptr);
+    return c;
+}
 
 // ---------------- Load CSV ----------------
+// Number of workers used to parse the CSV. Files are cut into byte ranges at
+// newline boundaries, each range is parsed by its own ThreadWrapper and the
+// per-range results are appended to 'students' in file order.
+static int load_workers = 1;
+static const size_t MIN_BYTES_PER_LOAD_WORKER = 1 << 20; // small files stay single threaded
+
+static int default_load_workers() {
+#if defined(USE_STD_THREAD) || defined(USE_POSIX)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#else
+    return 1; // fallback workers run synchronously, splitting buys nothing
+#endif
+}
+
+// Append one CSV row to 'out'; junk grades / years are stored as 0 (as before)
+// and counted in 'stats'. Fields with inner quotes are copied into 'copies'.
+static bool parse_row(string_view line, StudentStore &out, FastCSV::ParseStats &stats, FastCSV::Unquoted &copies) {
+    string_view cols[6];
+    if (FastCSV::split_fields(line, cols, 6, copies) < 6) return false;
+    int year;
+    if (!FastCSV::parse_int(trim(cols[3]), year)) ++stats.bad_years;
+    out.begin_row(trim(cols[0]), trim(cols[1]), trim(cols[2]), year);
+    FastCSV::for_each_semi(cols[4], [&](string_view tok){ out.add_current(tok); });
+    FastCSV::for_each_prev(cols[5], [&](string_view code, string_view gradeS){
+        double g;
+        if (!FastCSV::parse_grade(gradeS, g)) ++stats.bad_grades;
+        out.add_prev(code, g);
+    });
+    out.end_row();
+    return true;
+}
+
+static void parse_range(string_view chunk, StudentStore &out, FastCSV::ParseStats &stats, FastCSV::Unquoted &copies) {
+    string_view line;
+    while (FastCSV::next_line(chunk, line)) {
+        if (trim(line).empty()) continue;
+        parse_row(line, out, stats, copies);
+    }
+}
+
+// Parse every row of 'body' and append the students to 'out' in file order,
+// fanning out over load_workers byte ranges when the body is large enough.
+// Text copied to drop inner quotes is added to 'backing'.
+static void parse_body(string_view body, StudentStore &out, FastCSV::ParseStats &stats, Backing &backing) {
+    size_t parts = max<size_t>(1, min<size_t>((size_t)max(1, load_workers), body.size() / MIN_BYTES_PER_LOAD_WORKER));
+    vector<FastCSV::Unquoted> copies(parts);
+    auto keep_copies = [&]() {
+        for (auto &c : copies) if (!c.empty()) backing.push_back(make_shared<const FastCSV::Unquoted>(move(c)));
+    };
+    if (parts == 1) {
+        parse_range(body, out, stats, copies[0]);
+        keep_copies();
+        return;
+    }
+    auto ranges = FastCSV::split_ranges(body, parts);
+    // each worker fills its own store on the heap, dropped once its rows are copied into out's arena
+    vector<StudentStore> partial(ranges.size());
+    vector<FastCSV::ParseStats> partial_stats(ranges.size());
+    vector<unique_ptr<ThreadWrapper>> th(ranges.size());
+    for (size_t p = 0; p < ranges.size(); ++p) {
+        th[p] = make_unique<ThreadWrapper>();
+        string_view chunk = ranges[p];
+        StudentStore *dst = &partial[p];
+        FastCSV::ParseStats *st = &partial_stats[p];
+        FastCSV::Unquoted *cp = &copies[p];
+        th[p]->start([chunk, dst, st, cp](){ parse_range(chunk, *dst, *st, *cp); });
+    }
+    for (auto &t : th) t->join();
+    for (auto &st : partial_stats) stats += st;
+    keep_copies();
+    for (auto &part : partial) out.append(move(part));
+}
+
+// add the grades of students [from, size()) of g to its grade index and bitmaps
+// Large batches are split into contiguous row blocks scanned by pool tasks into
+// private lists; then, courses spread over the pool, every course sorts its new
+// postings. A batch that is small next to the course's list is inserted one
+// posting at a time, O(log n) each; a larger one (a full load) is merged with
+// the list in one pass and the list is rebuilt from the result. A grade
+// field that failed to parse (junk, or outside 0..10 like "nan" or "1e300") is
+// stored as 0 (see FastCSV::ParseStats) and is indexed as 0, so ranges that
+// include 0 ("ML >= 0") count those rows. A NaN grade, which only a snapshot
+// written by an older build can hold, matches no range and is left out.
+static const size_t MIN_ROWS_PER_INDEX_WORKER = 1 << 15;
+static const size_t INSERT_FRACTION = 16; // batches below list size / 16 are inserted one by one
+static void index_students(Generation &g, size_t from) {
+    const StudentStore &students = g.students;
+    vector<List> &grade_index = g.grade_index;
+    auto &grade_bitmaps = g.grade_bitmaps;
+    size_t n = students.size();
+    if (from >= n) return;
+    if (grade_index.size() < students.courses.size()) grade_index.resize(students.courses.size());
+    size_t courses = grade_index.size();
+    struct Posting { double grade; uint32_t student; };
+    auto before = [](const Posting &a, const Posting &b) { return grade_before(a.grade, a.student, b.grade, b.student); };
+    size_t parts = fork_parts(n - from, MIN_ROWS_PER_INDEX_WORKER);
+    vector<vector<vector<Posting>>> local(parts, vector<vector<Posting>>(courses));
+    run_parts(parts, [&](size_t p) {
+        auto &mine = local[p];
+        size_t b = from + ((n - from) * p) / parts, e = from + ((n - from) * (p + 1)) / parts;
+        for (size_t i = b; i < e; ++i)
+            for (size_t k = students.prev_begin(i); k < students.prev_end(i); ++k)
+                if (!isnan(students.prev_grade[k])) mine[students.prev_course[k]].push_back({students.prev_grade[k], (uint32_t)i});
+    }, nullptr);
+    if (grade_bitmaps.size() < courses) grade_bitmaps.resize(courses);
+    size_t course_parts = max<size_t>(1, min(pool_size(), courses));
+    run_parts(course_parts, [&](size_t p) {
+        vector<Posting> add;
+        vector<double> grade;
+        vector<uint32_t> student;
+        for (size_t c = p; c < courses; c += course_parts) {
+            add.clear();
+            for (auto &l : local) add.insert(add.end(), l[c].begin(), l[c].end());
+            if (add.empty()) continue;
+            // new rows come after every indexed one, so in row order each bitmap only appends
+            GradeBuckets &buckets = grade_bitmaps[c].edit();
+            for (const Posting &g : add) buckets[grade_bucket(g.grade)].add(g.student);
+            sort(add.begin(), add.end(), before);
+            List &list = grade_index[c];
+            if (add.size() < list.size() / INSERT_FRACTION) {
+                for (const Posting &g : add) list.insert(g.grade, g.student);
+                continue;
+            }
+            grade.clear();
+            student.clear();
+            size_t j = 0;
+            auto take = [&](double pg, uint32_t ps) { grade.push_back(pg); student.push_back(ps); };
+            list.for_each([&](double pg, uint32_t ps) {
+                for (; j < add.size() && before(add[j], {pg, ps}); ++j) take(add[j].grade, add[j].student);
+                take(pg, ps);
+            });
+            for (; j < add.size(); ++j) take(add[j].grade, add[j].student);
+            list = List::build(grade.data(), student.data(), grade.size(), g.arena);
+        }
+    }, nullptr);
+}
+
+// Positions [first, last) of the postings of course c with lo <= grade <= hi.
+static pair<size_t, size_t> grade_range(const Generation &gen, uint32_t c, double lo, double hi = numeric_limits<double>::infinity()) {
+    if (c >= gen.grade_index.size()) return {0, 0};
+    return gen.grade_index[c].range(lo, hi);
+}
+
+static size_t grade_count(const Generation &gen, uint32_t c, double lo, double hi = numeric_limits<double>::infinity()) {
+    auto r = grade_range(gen, c, lo, hi);
+    return r.second - r.first;
+}
+
+// Students with at least one grade >= x in course c: the buckets above x's
+// bucket are OR-ed whole; x's own bucket is added exactly from the postings
+// (or whole, when x is its lower edge).
+static Roaring::Bitmap students_at_least(const Generation &g, uint32_t c, double x) {
+    const auto &grade_bitmaps = g.grade_bitmaps;
+    Roaring::Bitmap out;
+    if (c >= grade_bitmaps.size()) return out;
+    size_t b = grade_bucket(x);
+    for (size_t k = b + 1; k < GRADE_BUCKETS; ++k) out |= grade_bitmaps[c][k];
+    if (x == (double)b && b > 0) return out | grade_bitmaps[c][b];
+    size_t from = b + 1 < GRADE_BUCKETS ? grade_range(g, c, (double)(b + 1)).second : 0, to = grade_range(g, c, x).second;
+    vector<uint32_t> ids;
+    g.grade_index[c].for_each(from, to, [&](double, uint32_t s) { ids.push_back(s); });
+    sort(ids.begin(), ids.end());
+    Roaring::Bitmap part;
+    for (uint32_t id : ids) part.add(id);
+    return out | part;
+}
+
+static void remember_csv_tail(const string &filename, uint64_t offset);
+
+// Parse 'filename' into a new generation and publish it (writers only: index_mtx held).
 bool load_csv(const string &filename = "students_3000.csv") {
-    students.clear();
-    high_grade_index.clear();
-    ifstream fin(filename);
-    if (!fin) {
+    auto file = make_shared<FastCSV::MappedFile>();
+    if (!file->open(filename)) {
         cerr << "ERROR: cannot open '" << filename << "'\n";
         return false;
     }
-    string header;
-    getline(fin, header);
-    string line;
-    size_t idx = 0;
-    while (getline(fin, line)) {
-        if (trim(line).empty()) continue;
-        auto cols = split_csv_line(line);
-        if (cols.size() < 6) continue;
-        Student s;
-        string name = cols[0];
-        if (!name.empty() && name.front() == '"') name = name.substr(1);
-        if (!name.empty() && name.back() == '"') name.pop_back();
-        s.name = trim(name);
-        string roll = cols[1];
-        if (!roll.empty() && roll.front() == '"') roll = roll.substr(1);
-        if (!roll.empty() && roll.back() == '"') roll.pop_back();
-        s.roll = trim(roll);
-        s.branch = trim(cols[2]);
-        try { s.start_year = stoi(trim(cols[3])); } catch(...) { s.start_year = 0; }
-        s.current_courses = parse_semis(cols[4]);
-        s.prev_courses = parse_prev(cols[5]);
-        students.push_back(move(s));
-        ++idx;
-    }
-    fin.close();
-    // build high-grade index
-    for (size_t i = 0; i < students.size(); ++i) {
-        for (auto &pg : students[i].prev_courses) {
-            if (pg.second >= 9.0) high_grade_index[trim(pg.first)].push_back(i);
+    shared_ptr<Generation> g = new_generation();
+    g->backing.push_back(file);
+
+    string_view body = file->view(), header;
+    FastCSV::next_line(body, header);
+    // A last line without '\n' may be a row still being written. It is left
+    // past the tail, so ingest_appended() parses it once, when it is finished,
+    // instead of a truncated row now and the rest of it as another row later.
+    size_t last_nl = body.rfind('\n');
+    size_t held = last_nl == string_view::npos ? body.size() : body.size() - last_nl - 1;
+    body.remove_suffix(held);
+    if (held) cerr << "NOTE: the last line of '" << filename << "' has no newline yet; it is read once it is finished (option 6 / 8).\n";
+    parse_body(body, g->students, g->load_stats, g->backing);
+    index_students(*g, 0);
+    remember_csv_tail(filename, file->size() - held);
+    publish(g);
+    return true;
+}
+
+static string rejected_fields_text(const FastCSV::ParseStats &stats) {
+    if (!stats.rejected()) return "";
+    return "Rejected fields: " + to_string(stats.bad_grades) + " grade(s), "
+         + to_string(stats.bad_years) + " start year(s) (stored as 0).\n";
+}
+
+// ---------------- Binary snapshot ----------------
+// save_snapshot() writes the parsed store, the course dictionary, grade_index
+// and the bucket bitmaps into one versioned file; load_snapshot() maps it and
+// builds nothing it can point at: the numeric store columns are wrapped around
+// their mapped sections (Cow::Column::wrap, no copy until an edit writes to a
+// chunk), so are the leaves of the postings lists (List::wrap builds only the
+// inner nodes, one per 256 postings), the text columns point into the mapped
+// text blob, and a warm start does no text parsing and no sorting at all. What
+// is still built: one string_view per name and roll (by the pool, a run of
+// chunks per worker) and the bitmap containers (one copy each).
+// The file is not checked row by row: the header holds each section's length
+// and checksum (section_sums(), summed by the pool at memory speed), and only
+// what is small next to the rows is checked for consistency (dictionaries,
+// the CSR offsets' ends, index_off, the bitmap containers).
+// Layout (native byte order, every section 8-byte aligned):
+//
+//   SnapHeader | text blob | SnapStr names[n] | SnapStr rolls[n] | uint64 roll_code[n]
+//   | SnapStr branches[b] | uint32 branch_id[n] | int32 start_year[n]
+//   | SnapStr courses[c] | uint32 cur_off[n+1] | uint32 cur_ids[]
+//   | uint32 prev_off[n+1] | uint32 prev_len[n] | uint32 prev_ids[] | double prev_grades[]
+//   | uint32 index_off[c+1] | uint32 postings[] | double posting_grades[]
+//   | uint32 bitmap_off[c*GRADE_BUCKETS+1] | SnapContainer containers[]
+//   | uint16 bitmap_values[] | uint64 bitmap_words[]
+//
+// Course lists are stored as ids into the course dictionary, and the index is
+// CSR: postings[index_off[c] .. index_off[c+1]) are the students graded in
+// course c, with their grades in posting_grades, in grade_index order. Bucket
+// b of course c is containers[bitmap_off[c*GRADE_BUCKETS+b] .. the next one),
+// each with its values in bitmap_values (sparse) or its words in bitmap_words
+// (dense) from 'at' on. The header records size + mtime of the source CSV so a stale
+// snapshot is never used, and how many of its bytes the data reflects: less
+// than the size when the last line had no newline yet (see load_csv()).
+static const char SNAP_MAGIC[8] = {'E','R','P','S','N','A','P','\0'};
+static const uint32_t SNAP_VERSION = 6;
+
+struct SnapSection { uint64_t offset, count, sum; };
+struct SnapHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t source_size;
+    int64_t source_mtime_ns;
+    uint64_t source_offset; // bytes of the source reflected, <= source_size
+    SnapSection text, names, rolls, roll_code, branches, branch_id, start_year, courses,
+                cur_off, cur_ids, prev_off, prev_len, prev_ids, prev_grades, index_off, postings, posting_grades,
+                bitmap_off, containers, bitmap_values, bitmap_words;
+};
+struct SnapStr { uint32_t off, len; };
+struct SnapContainer { uint16_t key, dense; uint32_t card; uint64_t at; };
+
+// every section with the size of its elements, in file order
+struct SnapSectionInfo { SnapSection SnapHeader::*sec; size_t elem; };
+static const SnapSectionInfo SNAP_SECTIONS[] = {
+    { &SnapHeader::text, 1 }, { &SnapHeader::names, sizeof(SnapStr) }, { &SnapHeader::rolls, sizeof(SnapStr) },
+    { &SnapHeader::roll_code, 8 }, { &SnapHeader::branches, sizeof(SnapStr) }, { &SnapHeader::branch_id, 4 },
+    { &SnapHeader::start_year, 4 }, { &SnapHeader::courses, sizeof(SnapStr) }, { &SnapHeader::cur_off, 4 },
+    { &SnapHeader::cur_ids, 4 }, { &SnapHeader::prev_off, 4 }, { &SnapHeader::prev_len, 4 }, { &SnapHeader::prev_ids, 4 },
+    { &SnapHeader::prev_grades, 8 }, { &SnapHeader::index_off, 4 }, { &SnapHeader::postings, 4 },
+    { &SnapHeader::posting_grades, 8 }, { &SnapHeader::bitmap_off, 4 }, { &SnapHeader::containers, sizeof(SnapContainer) },
+    { &SnapHeader::bitmap_values, 2 }, { &SnapHeader::bitmap_words, 8 },
+};
+static const size_t SNAP_SECTION_COUNT = sizeof SNAP_SECTIONS / sizeof SNAP_SECTIONS[0];
+
+// Checksum of len bytes: four lanes of running sums of the 64-bit words and
+// of those sums (Fletcher style, plain adds the compiler vectorizes, so it runs
+// at memory speed), mixed at the end with xxHash64's round; the last partial
+// word is zero-padded. It catches a torn or damaged file, not a crafted one.
+static const uint64_t SUM_P1 = 0x9E3779B185EBCA87ULL, SUM_P2 = 0xC2B2AE3D27D4EB4FULL;
+static uint64_t sum_round(uint64_t acc, uint64_t w) {
+    acc += w * SUM_P2;
+    acc = (acc << 31) | (acc >> 33);
+    return acc * SUM_P1;
+}
+static uint64_t block_sum(const char *p, size_t len) {
+    uint64_t a[4] = { 1, 2, 3, 4 }, b[4] = { 0, 0, 0, 0 };
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        uint64_t w[4];
+        memcpy(w, p + i, sizeof w);
+        for (int l = 0; l < 4; ++l) { a[l] += w[l]; b[l] += a[l]; }
+    }
+    uint64_t h = len;
+    for (int l = 0; l < 4; ++l) h = sum_round(sum_round(h, a[l]), b[l]);
+    for (; i < len; i += 8) { uint64_t w = 0; memcpy(&w, p + i, min<size_t>(8, len - i)); h = sum_round(h, w); }
+    return h;
+}
+
+// The checksum of every section of the file at 'base' (in SNAP_SECTIONS
+// order): the sections' 1 MB blocks are summed by the pool, then combined in
+// order. The sections must lie inside the file.
+static const size_t SNAP_SUM_BLOCK = 1 << 20;
+static vector<uint64_t> section_sums(const char *base, const SnapHeader &h) {
+    struct Block { size_t section; uint64_t offset, len, sum; };
+    vector<Block> blocks;
+    for (size_t i = 0; i < SNAP_SECTION_COUNT; ++i) {
+        const SnapSection &sec = h.*SNAP_SECTIONS[i].sec;
+        uint64_t bytes = sec.count * SNAP_SECTIONS[i].elem;
+        for (uint64_t b = 0; b < bytes; b += SNAP_SUM_BLOCK) blocks.push_back({ i, sec.offset + b, min<uint64_t>(SNAP_SUM_BLOCK, bytes - b), 0 });
+    }
+    size_t parts = fork_parts(blocks.size(), 4);
+    run_parts(parts, [&](size_t p) {
+        for (size_t k = p; k < blocks.size(); k += parts) blocks[k].sum = block_sum(base + blocks[k].offset, (size_t)blocks[k].len);
+    }, nullptr);
+    vector<uint64_t> sums(SNAP_SECTION_COUNT, 0);
+    for (const Block &b : blocks) sums[b.section] = sum_round(sums[b.section], b.sum);
+    return sums;
+}
+
+static int64_t mtime_ns_of(const struct stat &st) { return (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec; }
+
+static bool source_stamp(const string &csvfile, uint64_t &size, int64_t &mtime_ns) {
+    struct stat st;
+    if (stat(csvfile.c_str(), &st) != 0) return false;
+    size = (uint64_t)st.st_size;
+    mtime_ns = mtime_ns_of(st);
+    return true;
+}
+
+// 'source_size' / 'source_mtime_ns' describe the CSV the snapshot is valid
+// for, 'source_offset' how much of it 'g' reflects.
+bool save_snapshot(const Generation &g, const string &path, uint64_t source_size, int64_t source_mtime_ns, uint64_t source_offset) {
+    SnapHeader h;
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, SNAP_MAGIC, sizeof h.magic);
+    h.version = SNAP_VERSION;
+    h.source_size = source_size;
+    h.source_mtime_ns = source_mtime_ns;
+    h.source_offset = source_offset;
+
+    string text;
+    auto add_text = [&](string_view v) { SnapStr r{ (uint32_t)text.size(), (uint32_t)v.size() }; text.append(v); return r; };
+
+    // the store's dictionary ids are written as-is
+    const StudentStore &st = g.students;
+    const vector<List> &grade_index = g.grade_index;
+    vector<SnapStr> names(st.size()), rolls(st.size()), branches(st.branches.size()), courses(st.courses.size());
+    for (size_t i = 0; i < st.size(); ++i) { names[i] = add_text(st.name[i]); rolls[i] = add_text(st.roll[i]); }
+    for (uint32_t b = 0; b < branches.size(); ++b) branches[b] = add_text(st.branches[b]);
+    for (uint32_t c = 0; c < courses.size(); ++c) courses[c] = add_text(st.courses[c]);
+    if (text.size() > UINT32_MAX) {
+        cerr << "ERROR: dataset too large for snapshot format v" << SNAP_VERSION << "\n";
+        return false;
+    }
+    vector<uint32_t> index_off(courses.size() + 1, 0), postings;
+    vector<double> posting_grades;
+    for (uint32_t c = 0; c < courses.size(); ++c) {
+        index_off[c] = (uint32_t)postings.size();
+        if (c < grade_index.size())
+            grade_index[c].for_each([&](double pg, uint32_t ps) { postings.push_back(ps); posting_grades.push_back(pg); });
+    }
+    index_off[courses.size()] = (uint32_t)postings.size();
+    // rows moved or shrunk by registrar edits are written back in row order
+    const Cow::Column<uint32_t> *prev_off = &st.prev_off, *prev_len = &st.prev_len, *prev_ids = &st.prev_course;
+    const Cow::Column<double> *prev_grades = &st.prev_grade;
+    Cow::Column<uint32_t> packed_off, packed_len, packed_ids;
+    Cow::Column<double> packed_grades;
+    if (!st.prev_packed()) {
+        packed_off.push_back(0);
+        for (size_t i = 0; i < st.size(); ++i) {
+            for (size_t k = st.prev_begin(i); k < st.prev_end(i); ++k) {
+                packed_ids.push_back(st.prev_course[k]);
+                packed_grades.push_back(st.prev_grade[k]);
+            }
+            packed_off.push_back((uint32_t)packed_ids.size());
+            packed_len.push_back(st.prev_len[i]);
+        }
+        prev_off = &packed_off; prev_len = &packed_len; prev_ids = &packed_ids; prev_grades = &packed_grades;
+    }
+    // the bucket bitmaps, container by container
+    vector<uint32_t> bitmap_off;
+    vector<SnapContainer> containers;
+    vector<uint16_t> bitmap_values;
+    vector<uint64_t> bitmap_words;
+    for (uint32_t c = 0; c < courses.size(); ++c) {
+        for (size_t b = 0; b < GRADE_BUCKETS; ++b) {
+            bitmap_off.push_back((uint32_t)containers.size());
+            if (c >= g.grade_bitmaps.size()) continue;
+            g.grade_bitmaps[c][b].for_each_container([&](uint16_t key, uint32_t card, const uint16_t *values, const uint64_t *bits) {
+                containers.push_back({ key, (uint16_t)(bits != nullptr), card, bits ? bitmap_words.size() : bitmap_values.size() });
+                if (bits) bitmap_words.insert(bitmap_words.end(), bits, bits + Roaring::Bitmap::WORDS);
+                else bitmap_values.insert(bitmap_values.end(), values, values + card);
+            });
+        }
+    }
+    bitmap_off.push_back((uint32_t)containers.size());
+
+    string tmp = path + ".tmp";
+    ofstream fout(tmp, ios::binary | ios::trunc);
+    if (!fout) { cerr << "ERROR: cannot write '" << tmp << "'\n"; return false; }
+    uint64_t pos = sizeof h;
+    fout.write(reinterpret_cast<const char*>(&h), sizeof h); // patched below
+    auto start = [&](SnapSection &sec, size_t count) {
+        static const char zeros[8] = {0};
+        size_t pad = (8 - pos % 8) % 8;
+        fout.write(zeros, (streamsize)pad); pos += pad;
+        sec.offset = pos; sec.count = count;
+    };
+    auto put = [&](SnapSection &sec, const void *data, size_t elem, size_t count) {
+        start(sec, count);
+        fout.write(static_cast<const char*>(data), (streamsize)(elem * count)); pos += elem * count;
+    };
+    // a store column, one chunk at a time
+    auto put_column = [&](SnapSection &sec, const auto &col) {
+        start(sec, col.size());
+        col.scan(0, col.size(), [&](const auto *data, size_t count) {
+            fout.write(reinterpret_cast<const char*>(data), (streamsize)(sizeof *data * count)); pos += sizeof *data * count;
+        });
+    };
+    put(h.text, text.data(), 1, text.size());
+    put(h.names, names.data(), sizeof(SnapStr), names.size());
+    put(h.rolls, rolls.data(), sizeof(SnapStr), rolls.size());
+    put_column(h.roll_code, st.roll_code);
+    put(h.branches, branches.data(), sizeof(SnapStr), branches.size());
+    put_column(h.branch_id, st.branch_id);
+    put_column(h.start_year, st.start_year);
+    put(h.courses, courses.data(), sizeof(SnapStr), courses.size());
+    static const uint32_t no_rows_off = 0; // offsets of an empty store
+    if (st.empty()) put(h.cur_off, &no_rows_off, sizeof(uint32_t), 1);
+    else put_column(h.cur_off, st.cur_off);
+    put_column(h.cur_ids, st.cur_course);
+    if (st.empty()) put(h.prev_off, &no_rows_off, sizeof(uint32_t), 1);
+    else put_column(h.prev_off, *prev_off);
+    put_column(h.prev_len, *prev_len);
+    put_column(h.prev_ids, *prev_ids);
+    put_column(h.prev_grades, *prev_grades);
+    put(h.index_off, index_off.data(), sizeof(uint32_t), index_off.size());
+    put(h.postings, postings.data(), sizeof(uint32_t), postings.size());
+    put(h.posting_grades, posting_grades.data(), sizeof(double), posting_grades.size());
+    put(h.bitmap_off, bitmap_off.data(), sizeof(uint32_t), bitmap_off.size());
+    put(h.containers, containers.data(), sizeof(SnapContainer), containers.size());
+    put(h.bitmap_values, bitmap_values.data(), sizeof(uint16_t), bitmap_values.size());
+    put(h.bitmap_words, bitmap_words.data(), sizeof(uint64_t), bitmap_words.size());
+    // the checksums are taken from the file as written
+    fout.flush();
+    FastCSV::MappedFile written;
+    bool summed = fout && written.open(tmp) && written.size() == pos;
+    if (summed) {
+        vector<uint64_t> sums = section_sums(written.data(), h);
+        for (size_t i = 0; i < SNAP_SECTION_COUNT; ++i) (h.*SNAP_SECTIONS[i].sec).sum = sums[i];
+    }
+    fout.seekp(0);
+    fout.write(reinterpret_cast<const char*>(&h), sizeof h);
+    fout.close();
+    if (!summed || !fout || rename(tmp.c_str(), path.c_str()) != 0) {
+        cerr << "ERROR: failed to write snapshot '" << path << "'\n";
+        remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Publishes the snapshot as a new generation (writers only: index_mtx held).
+// Returns false (leaving the current data untouched) when the snapshot is
+// missing, from another version, does not match 'csvfile' or is corrupt.
+bool load_snapshot(const string &path, const string &csvfile) {
+    auto file = make_shared<FastCSV::MappedFile>();
+    FastCSV::MappedFile &map = *file;
+    if (!map.open(path) || map.size() < sizeof(SnapHeader)) return false;
+    SnapHeader h;
+    memcpy(&h, map.data(), sizeof h);
+    if (memcmp(h.magic, SNAP_MAGIC, sizeof h.magic) != 0 || h.version != SNAP_VERSION) return false;
+    uint64_t size = 0; int64_t mtime = 0;
+    if (!source_stamp(csvfile, size, mtime) || size != h.source_size || mtime != h.source_mtime_ns
+        || h.source_offset > h.source_size) return false;
+    // lengths: every section inside the file, the counts consistent
+    for (const SnapSectionInfo &si : SNAP_SECTIONS) {
+        const SnapSection &sec = h.*si.sec;
+        if (sec.offset % 8 != 0 || sec.offset > map.size() || sec.count > (map.size() - sec.offset) / si.elem) return false;
+    }
+    uint64_t n = h.names.count;
+    if (h.rolls.count != n || h.roll_code.count != n || h.branch_id.count != n || h.start_year.count != n
+        || h.cur_off.count != n + 1 || h.prev_off.count != n + 1 || h.prev_len.count != n
+        || h.prev_grades.count != h.prev_ids.count || h.index_off.count != h.courses.count + 1
+        || h.posting_grades.count != h.postings.count || h.bitmap_off.count != h.courses.count * GRADE_BUCKETS + 1) return false;
+
+    const char *base = map.data();
+    const char *text = base + h.text.offset;
+    auto str = [&](const SnapStr &r) { return string_view(text + r.off, r.len); };
+    auto str_ok = [&](const SnapStr &r) { return (uint64_t)r.off + r.len <= h.text.count; };
+    const SnapStr *names = reinterpret_cast<const SnapStr*>(base + h.names.offset);
+    const SnapStr *rolls = reinterpret_cast<const SnapStr*>(base + h.rolls.offset);
+    const uint64_t *roll_code = reinterpret_cast<const uint64_t*>(base + h.roll_code.offset);
+    const SnapStr *branches = reinterpret_cast<const SnapStr*>(base + h.branches.offset);
+    const uint32_t *branch_id = reinterpret_cast<const uint32_t*>(base + h.branch_id.offset);
+    const int32_t *start_year = reinterpret_cast<const int32_t*>(base + h.start_year.offset);
+    const SnapStr *courses = reinterpret_cast<const SnapStr*>(base + h.courses.offset);
+    const uint32_t *cur_off = reinterpret_cast<const uint32_t*>(base + h.cur_off.offset);
+    const uint32_t *cur_ids = reinterpret_cast<const uint32_t*>(base + h.cur_ids.offset);
+    const uint32_t *prev_off = reinterpret_cast<const uint32_t*>(base + h.prev_off.offset);
+    const uint32_t *prev_len = reinterpret_cast<const uint32_t*>(base + h.prev_len.offset);
+    const uint32_t *prev_ids = reinterpret_cast<const uint32_t*>(base + h.prev_ids.offset);
+    const double *prev_grades = reinterpret_cast<const double*>(base + h.prev_grades.offset);
+    const uint32_t *index_off = reinterpret_cast<const uint32_t*>(base + h.index_off.offset);
+    const uint32_t *postings = reinterpret_cast<const uint32_t*>(base + h.postings.offset);
+    const double *posting_grades = reinterpret_cast<const double*>(base + h.posting_grades.offset);
+    const uint32_t *bitmap_off = reinterpret_cast<const uint32_t*>(base + h.bitmap_off.offset);
+    const SnapContainer *containers = reinterpret_cast<const SnapContainer*>(base + h.containers.offset);
+    const uint16_t *bitmap_values = reinterpret_cast<const uint16_t*>(base + h.bitmap_values.offset);
+    const uint64_t *bitmap_words = reinterpret_cast<const uint64_t*>(base + h.bitmap_words.offset);
+
+    // contents: the checksums, then what is small next to the rows
+    vector<uint64_t> sums = section_sums(base, h);
+    for (size_t i = 0; i < SNAP_SECTION_COUNT; ++i) if (sums[i] != (h.*SNAP_SECTIONS[i].sec).sum) return false;
+    if (cur_off[0] != 0 || prev_off[0] != 0 || cur_off[n] != h.cur_ids.count || prev_off[n] != h.prev_ids.count) return false;
+    unordered_set<string_view> seen;
+    for (uint64_t b = 0; b < h.branches.count; ++b)
+        if (!str_ok(branches[b]) || !seen.insert(str(branches[b])).second) return false;
+    seen.clear();
+    for (uint64_t c = 0; c < h.courses.count; ++c)
+        if (!str_ok(courses[c]) || !seen.insert(str(courses[c])).second) return false;
+    for (uint64_t c = 0; c < h.courses.count; ++c)
+        if (index_off[c] > index_off[c + 1] || index_off[c + 1] > h.postings.count) return false;
+
+    shared_ptr<Generation> g = new_generation();
+    g->from_snapshot = true;
+    g->backing.push_back(file);
+    StudentStore &students = g->students;
+    vector<List> &grade_index = g->grade_index;
+
+    // the bitmaps are checked while they are read back; g is dropped if one is bad
+    g->grade_bitmaps.resize(h.courses.count);
+    for (uint64_t c = 0; c < h.courses.count; ++c) {
+        for (size_t b = 0; b < GRADE_BUCKETS; ++b) {
+            uint32_t first = bitmap_off[c * GRADE_BUCKETS + b], last = bitmap_off[c * GRADE_BUCKETS + b + 1];
+            if (first > last || last > h.containers.count) return false;
+            if (first == last) continue;
+            Roaring::Bitmap &bm = g->grade_bitmaps[c].edit()[b];
+            for (uint32_t k = first; k < last; ++k) {
+                const SnapContainer &sc = containers[k];
+                bool dense = sc.dense != 0;
+                uint64_t len = dense ? Roaring::Bitmap::WORDS : sc.card, pool = dense ? h.bitmap_words.count : h.bitmap_values.count;
+                if (len > pool || sc.at > pool - len
+                    || !bm.append_container(sc.key, sc.card, dense ? nullptr : bitmap_values + sc.at, dense ? bitmap_words + sc.at : nullptr)) return false;
+            }
+            if (bm.last() >= n) return false;
         }
     }
+
+    // rebuild the dictionaries in file order so the stored ids stay valid
+    for (uint64_t b = 0; b < h.branches.count; ++b) students.intern_branch(str(branches[b]));
+    for (uint64_t c = 0; c < h.courses.count; ++c) students.courses.intern(str(courses[c]));
+    // names and rolls become string_views into the mapped text: each pool
+    // worker fills whole chunks of its own columns, which the store then shares
+    const uint64_t CHUNK = Cow::Column<string_view>::CHUNK, chunks = (n + CHUNK - 1) / CHUNK;
+    size_t parts = fork_parts((size_t)chunks, 4);
+    vector<Cow::Column<string_view>> name_part(parts), roll_part(parts);
+    run_parts(parts, [&](size_t p) {
+        vector<string_view> views((size_t)CHUNK);
+        name_part[p].use(g->arena);
+        roll_part[p].use(g->arena);
+        for (uint64_t b = chunks * p / parts * CHUNK; b < min(n, chunks * (p + 1) / parts * CHUNK); b += CHUNK) {
+            size_t k = (size_t)min(n - b, CHUNK);
+            for (size_t j = 0; j < k; ++j) views[j] = str(names[b + j]);
+            name_part[p].append(views.data(), k);
+            for (size_t j = 0; j < k; ++j) views[j] = str(rolls[b + j]);
+            roll_part[p].append(views.data(), k);
+        }
+    }, nullptr);
+    for (size_t p = 0; p < parts; ++p) {
+        students.name.append(name_part[p]);
+        students.roll.append(roll_part[p]);
+    }
+    // every numeric column reads the mapping in place ('file' is in g->backing)
+    students.roll_code.wrap(roll_code, n);
+    students.branch_id.wrap(branch_id, n);
+    students.start_year.wrap(start_year, n);
+    students.cur_off.wrap(cur_off, n + 1);
+    students.cur_course.wrap(cur_ids, h.cur_ids.count);
+    students.prev_off.wrap(prev_off, n + 1);
+    students.prev_len.wrap(prev_len, n);
+    students.prev_course.wrap(prev_ids, h.prev_ids.count);
+    students.prev_grade.wrap(prev_grades, h.prev_grades.count);
+    grade_index.resize(h.courses.count);
+    for (size_t c = 0; c < grade_index.size(); ++c)
+        grade_index[c] = List::wrap(posting_grades + index_off[c], postings + index_off[c], index_off[c + 1] - index_off[c], g->arena);
+    remember_csv_tail(csvfile, h.source_offset);
+    publish(g);
+    return true;
+}
+
+// Load from the snapshot when it matches the CSV, otherwise parse the CSV
+// (writers only: index_mtx held).
+static string CSV_FILE = "students_3000.csv"; // --csv FILE
+static string SNAP_FILE = "students_3000.snap"; // CSV_FILE with .snap extension
+
+bool load_data() {
+    return load_snapshot(SNAP_FILE, CSV_FILE) || load_csv(CSV_FILE);
+}
+
+// ---------------- Live append ingestion ----------------
+// The registrar only ever appends rows, so a reload normally just has to parse
+// the bytes past the end of what was loaded. csv_tail remembers that offset,
+// the file identity and a copy of the last bytes before it; ingest_appended()
+// maps only the new bytes, parses the complete lines into a copy of the
+// current generation (students and postings) and publishes it. The copy shares
+// all unchanged chunks, nodes and bitmaps (copy_generation()), so an append
+// costs O(appended rows * log n), not O(students). Anything that
+// is not a plain append (another inode, a shorter file, a changed tail, a
+// same-size rewrite) asks for a full reload instead. csv_tail belongs to the
+// writers (index_mtx).
+struct CsvTail {
+    bool valid = false;
+    dev_t dev = 0;
+    ino_t ino = 0;
+    uint64_t offset = 0;      // bytes of the file already reflected in 'students'
+    int64_t mtime_ns = 0;
+    string guard;             // copy of the bytes just before 'offset'
+};
+static CsvTail csv_tail;
+static const size_t TAIL_GUARD_BYTES = 4096;
+
+static bool read_file_range(const string &filename, uint64_t offset, size_t len, string &out) {
+    out.assign(len, '\0');
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    size_t got = 0;
+    while (got < len) {
+        ssize_t r = pread(fd, &out[got], len - got, (off_t)(offset + got));
+        if (r <= 0) break;
+        got += (size_t)r;
+    }
+    close(fd);
+    return got == len;
+}
+
+static void remember_csv_tail(const string &filename, uint64_t offset) {
+    csv_tail = CsvTail();
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) return;
+    size_t glen = (size_t)min<uint64_t>(offset, TAIL_GUARD_BYTES);
+    if (!read_file_range(filename, offset - glen, glen, csv_tail.guard)) return;
+    csv_tail.dev = st.st_dev;
+    csv_tail.ino = st.st_ino;
+    csv_tail.offset = offset;
+    csv_tail.mtime_ns = mtime_ns_of(st);
+    csv_tail.valid = true;
+}
+
+// true while 'filename' (as 'st' describes it) still starts with what csv_tail
+// reflects: the same file, not shorter, the guard bytes unchanged, and not
+// rewritten in place when its size is the same.
+static bool csv_tail_holds(const string &filename, const struct stat &st) {
+    if (!csv_tail.valid || st.st_dev != csv_tail.dev || st.st_ino != csv_tail.ino || (uint64_t)st.st_size < csv_tail.offset) return false;
+    if ((uint64_t)st.st_size == csv_tail.offset) return mtime_ns_of(st) == csv_tail.mtime_ns;
+    string guard;
+    return read_file_range(filename, csv_tail.offset - csv_tail.guard.size(), csv_tail.guard.size(), guard) && guard == csv_tail.guard;
+}
+
+// true when bytes [from, to) of 'filename' hold no newline (read 64 KB at a time)
+static bool no_newline_in(const string &filename, uint64_t from, uint64_t to) {
+    string block;
+    for (; from < to; from += block.size()) {
+        if (!read_file_range(filename, from, (size_t)min<uint64_t>(to - from, 1 << 16), block)) return false;
+        if (block.find('\n') != string::npos) return false;
+    }
     return true;
 }
 
+// Returns the number of students appended (0 when nothing new is complete yet),
+// or -1 when the file changed in a way that needs a full load_data().
+// Writers only: index_mtx held.
+long ingest_appended(const string &filename) {
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0 || !csv_tail_holds(filename, st)) return -1;
+    if ((uint64_t)st.st_size == csv_tail.offset) return 0;
+    int64_t mtime = mtime_ns_of(st);
+
+    auto file = make_shared<FastCSV::MappedFile>();
+    if (!file->open(filename, csv_tail.offset)) return -1;
+    string_view fresh = file->view();
+    size_t last_nl = fresh.rfind('\n');
+    if (last_nl == string_view::npos) return 0; // wait for the row to be finished
+    string_view complete = fresh.substr(0, last_nl + 1);
+
+    shared_ptr<Generation> g = copy_generation(*current_generation());
+    g->backing.push_back(file);
+    size_t first_new = g->students.size();
+    parse_body(complete, g->students, g->load_stats, g->backing);
+    index_students(*g, first_new);
+
+    csv_tail.offset += complete.size();
+    csv_tail.mtime_ns = mtime;
+    string tail = csv_tail.guard;
+    tail.append(complete.substr(complete.size() - min(complete.size(), TAIL_GUARD_BYTES)));
+    csv_tail.guard = tail.substr(tail.size() - min(tail.size(), TAIL_GUARD_BYTES));
+    publish(g);
+    return (long)(g->students.size() - first_new);
+}
+
+// Menu option 6 and the follower: apply appended rows, fall back to a full
+// load. Returns what happened ("" when nothing did and quiet_if_unchanged).
+static string reload_csv(bool quiet_if_unchanged = false) {
+    LockGuard writer(index_mtx);
+    auto t0 = Clock::now();
+    long added = ingest_appended(CSV_FILE);
+    if (added == 0 && quiet_if_unchanged) return "";
+    ostringstream msg;
+    if (added >= 0) {
+        double dur = chrono::duration_cast<ms>(Clock::now() - t0).count();
+        msg << fixed << setprecision(1) << "Appended " << added << " new students (" << current_generation()->students.size() << " total) in " << dur << " ms.\n";
+        return msg.str();
+    }
+    if (!load_data()) return "Reload failed.\n";
+    GenerationPtr g = current_generation();
+    msg << "Reloaded " << g->students.size() << " students" << (g->from_snapshot ? " (from snapshot)" : "") << ".\n"
+        << rejected_fields_text(g->load_stats);
+    return msg.str();
+}
+
+// Menu option 7. The snapshot is stamped with the CSV as it is now when the
+// published generation reflects all of it but a last line without a newline
+// (which a load would leave past the tail too), so it stays usable until the
+// file changes. Otherwise (rows appended but not ingested yet, or a rewrite)
+// the stamp is the part csv_tail reflects, so the snapshot is stale instead of
+// silently missing rows.
+static void action_save_snapshot() {
+    LockGuard writer(index_mtx); // the published generation and csv_tail agree while it is held
+    GenerationPtr gen = current_generation();
+    uint64_t size = csv_tail.offset, offset = csv_tail.offset;
+    int64_t mtime = csv_tail.mtime_ns;
+    struct stat st;
+    if (!csv_tail.valid) {
+        if (!source_stamp(CSV_FILE, size, mtime)) { cout << "Cannot stat " << CSV_FILE << "\n"; return; }
+        offset = size;
+    } else if (stat(CSV_FILE.c_str(), &st) == 0 && csv_tail_holds(CSV_FILE, st)
+               && no_newline_in(CSV_FILE, csv_tail.offset, (uint64_t)st.st_size)) {
+        size = (uint64_t)st.st_size;
+        mtime = mtime_ns_of(st);
+    }
+    auto t0 = Clock::now();
+    if (save_snapshot(*gen, SNAP_FILE, size, mtime, offset)) {
+        double dur = chrono::duration_cast<ms>(Clock::now() - t0).count();
+        cout << "Wrote " << SNAP_FILE << " (" << gen->students.size() << " students) in " << dur << " ms\n";
+    } else cout << "Snapshot failed.\n";
+}
+
+// Menu option 8: watch the CSV with inotify and ingest appends as they land.
+static const uint32_t CSV_WATCH_MASK = IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF;
+
+// inotify descriptor watching CSV_FILE (watch id in 'wd'), or -1 with the reason in 'error'
+static int watch_csv(int &wd, string &error) {
+    int ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (ifd < 0) { error = string("inotify unavailable: ") + strerror(errno); return -1; }
+    wd = inotify_add_watch(ifd, CSV_FILE.c_str(), CSV_WATCH_MASK);
+    if (wd < 0) { error = "Cannot watch " + CSV_FILE + ": " + strerror(errno); close(ifd); return -1; }
+    return ifd;
+}
+
+// Ingest appends whenever inotify reports a change, until 'stop_fd' becomes
+// readable (with watch_cin: or input is already buffered in cin). Every
+// reload_csv() result goes to 'report'. Closes 'ifd'.
+static void follow_loop(int ifd, int wd, int stop_fd, bool watch_cin, const function<void(const string&)> &report) {
+    alignas(inotify_event) char buf[4096];
+    while (!watch_cin || cin.rdbuf()->in_avail() <= 0) {
+        pollfd fds[2] = { { ifd, POLLIN, 0 }, { stop_fd, POLLIN, 0 } };
+        if (poll(fds, 2, -1) < 0) { if (errno == EINTR) continue; break; }
+        if (fds[1].revents) break;
+        if (!(fds[0].revents & POLLIN)) continue;
+        bool replaced = false;
+        ssize_t len;
+        while ((len = read(ifd, buf, sizeof buf)) > 0) {
+            for (char *p = buf; p < buf + len; p += sizeof(inotify_event) + reinterpret_cast<inotify_event*>(p)->len) {
+                if (reinterpret_cast<inotify_event*>(p)->mask & (IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED)) replaced = true;
+            }
+        }
+        if (replaced) { // file was swapped out (e.g. written via rename): watch the new one
+            inotify_rm_watch(ifd, wd);
+            wd = inotify_add_watch(ifd, CSV_FILE.c_str(), CSV_WATCH_MASK);
+            if (wd < 0) { report(CSV_FILE + " disappeared, stopping.\n"); break; }
+        }
+        string msg = reload_csv(true);
+        if (!msg.empty()) report(msg);
+    }
+    if (wd >= 0) inotify_rm_watch(ifd, wd);
+    close(ifd);
+}
+
+#if defined(USE_STD_THREAD) || defined(USE_POSIX)
+// Threaded builds follow in the background: the menu stays usable, every
+// action keeps reading the generation it started with while the follower
+// publishes new ones, and the follower's reports are printed before the next
+// menu. Choosing 8 again (or exiting) closes the stop pipe and joins it.
+struct BackgroundFollower {
+    WorkPool::OsThread thread;
+    int stop_pipe[2] = { -1, -1 };
+    MutexWrapper lock;     // guards 'notes'
+    vector<string> notes;  // reports not printed yet
+};
+static BackgroundFollower follower;
+
+static bool following() { return follower.stop_pipe[1] >= 0; }
+
+static void stop_following() {
+    if (!following()) return;
+    close(follower.stop_pipe[1]); // wakes the poll with POLLHUP
+    follower.thread.join();
+    close(follower.stop_pipe[0]);
+    follower.stop_pipe[0] = follower.stop_pipe[1] = -1;
+}
+
+static void print_follower_notes() {
+    vector<string> notes;
+    {
+        LockGuard g(follower.lock);
+        notes.swap(follower.notes);
+    }
+    for (auto &n : notes) cout << "[follow] " << n;
+}
+
+static void action_follow_csv() {
+    if (following()) { stop_following(); cout << "Stopped following.\n"; return; }
+    string error;
+    int wd = -1, ifd = watch_csv(wd, error);
+    if (ifd < 0) { cout << error << "\n"; return; }
+    if (pipe2(follower.stop_pipe, O_CLOEXEC) != 0) {
+        cout << "Cannot create the stop pipe: " << strerror(errno) << "\n";
+        follower.stop_pipe[0] = follower.stop_pipe[1] = -1;
+        close(ifd);
+        return;
+    }
+    int stop_fd = follower.stop_pipe[0];
+    follower.thread.start([ifd, wd, stop_fd]() {
+        follow_loop(ifd, wd, stop_fd, false, [](const string &msg) {
+            LockGuard g(follower.lock);
+            follower.notes.push_back(msg);
+        });
+    });
+    cout << "Following " << CSV_FILE << " for appended rows in the background (choose 8 again to stop).\n";
+}
+#else
+// Without threads the follower runs in the foreground until Enter is pressed.
+static bool following() { return false; }
+static void stop_following() {}
+static void print_follower_notes() {}
+
+static void action_follow_csv() {
+    string error;
+    int wd = -1, ifd = watch_csv(wd, error);
+    if (ifd < 0) { cout << error << "\n"; return; }
+    cout << "Following " << CSV_FILE << " for appended rows (press Enter to stop)...\n" << flush;
+    follow_loop(ifd, wd, STDIN_FILENO, true, [](const string &msg) { cout << msg << flush; });
+    string dummy;
+    if (cin.rdbuf()->in_avail() > 0 || !cin.eof()) getline(cin, dummy);
+    cout << "Stopped following.\n";
+}
+#endif
+
 // ---------------- Utilities ----------------
-bool student_cmp(const Student &a, const Student &b) {
-    if (a.branch != b.branch) return a.branch < b.branch;
-    if (a.start_year != b.start_year) return a.start_year < b.start_year;
-    return a.roll < b.roll;
+// Roll order is plain text order; two numeric rolls of the same length (the
+// RollNumber integer case) are settled on their encoded value instead.
+static bool roll_less(const StudentStore &st, uint32_t a, uint32_t b) {
+    uint64_t ra = st.roll_code[a], rb = st.roll_code[b];
+    if (ra != ROLL_NOT_NUMERIC && rb != ROLL_NOT_NUMERIC && st.roll[a].size() == st.roll[b].size()) return ra < rb;
+    return st.roll[a] < st.roll[b];
+}
+
+// Order by branch, start year, then roll (same order as comparing the text).
+// Branches compare by dictionary rank, so only the roll can touch strings.
+bool student_cmp(const StudentStore &st, uint32_t a, uint32_t b) {
+    if (st.branch_id[a] != st.branch_id[b]) return st.branch_rank[st.branch_id[a]] < st.branch_rank[st.branch_id[b]];
+    if (st.start_year[a] != st.start_year[b]) return st.start_year[a] < st.start_year[b];
+    return roll_less(st, a, b);
+}
+
+// ---------------- Radix sort ----------------
+// LSD radix sort of (key, row) pairs, one key byte per pass. Bytes that are the
+// same in every key are skipped, so packed sort keys of a few dozen bits take
+// 3-5 linear passes. Every pass is stable, so equal keys keep their row order.
+//
+// With parts > 1 the array is cut into one contiguous block per worker. Each
+// worker counts the digits of its block; the counts become per-worker output
+// offsets (worker w writes digit d after every smaller digit and after the
+// d's of workers < w), and each worker then scatters its own block. Worker p
+// adds its busy time to (*worker_times_ms)[p].
+struct KeyRow { uint64_t key; uint32_t row; };
+static const size_t MIN_ROWS_PER_RADIX_WORKER = 1 << 16;
+
+// Sort 'a' by key in place (stable).
+static void radix_sort_pairs(vector<KeyRow> &a, size_t parts = 1, vector<double> *worker_times_ms = nullptr) {
+    size_t n = a.size();
+    parts = max<size_t>(1, min(parts, max<size_t>(n, 1)));
+    if (worker_times_ms) worker_times_ms->assign(parts, 0.0);
+    uint64_t differs = 0; // bits that are not the same in every key
+    for (size_t i = 0; i < n; ++i) differs |= a[i].key ^ a[0].key;
+    if (!differs) return;
+    vector<KeyRow> b(n);
+    vector<size_t> block(parts + 1);
+    for (size_t p = 0; p <= parts; ++p) block[p] = (n * p) / parts;
+    vector<array<size_t, 256>> offset(parts);
+    for (int shift = 0; shift < 64; shift += 8) {
+        if (((differs >> shift) & 0xFF) == 0) continue;
+        run_parts(parts, [&](size_t p){
+            auto &cnt = offset[p];
+            cnt.fill(0);
+            for (size_t i = block[p]; i < block[p+1]; ++i) ++cnt[(a[i].key >> shift) & 0xFF];
+        }, worker_times_ms);
+        size_t sum = 0;
+        for (size_t d = 0; d < 256; ++d)
+            for (size_t p = 0; p < parts; ++p) { size_t c = offset[p][d]; offset[p][d] = sum; sum += c; }
+        run_parts(parts, [&](size_t p){
+            auto &pos = offset[p];
+            for (size_t i = block[p]; i < block[p+1]; ++i) b[pos[(a[i].key >> shift) & 0xFF]++] = a[i];
+        }, worker_times_ms);
+        a.swap(b);
+    }
+}
+
+// Rows 0..key.size()-1 ordered by key (stable).
+static vector<uint32_t> radix_sort_rows(const vector<uint64_t> &key, size_t parts = 1, vector<double> *worker_times_ms = nullptr) {
+    vector<KeyRow> a(key.size());
+    for (size_t i = 0; i < key.size(); ++i) a[i] = { key[i], (uint32_t)i };
+    radix_sort_pairs(a, parts, worker_times_ms);
+    vector<uint32_t> perm(a.size());
+    for (size_t i = 0; i < a.size(); ++i) perm[i] = a[i].row;
+    return perm;
+}
+
+// Workers for a radix sort that nobody asked a worker count for: one per pool
+// worker, but only when every worker gets a sizeable block.
+static size_t radix_workers(size_t n) {
+    return fork_parts(n, MIN_ROWS_PER_RADIX_WORKER);
+}
+
+// ---------------- Parallel merge ----------------
+// Merge path: the first k outputs of a stable merge of sorted a[0..na) and
+// b[0..nb) are a[0..i) and b[0..k-i) for the i returned here (on ties the
+// element of 'a' comes first). Binary search, O(log min(na, nb)).
+template<typename T, typename Less>
+static size_t co_rank(size_t k, const T *a, size_t na, const T *b, size_t nb, const Less &less) {
+    size_t lo = k > nb ? k - nb : 0, hi = min(k, na);
+    while (lo < hi) {
+        size_t i = lo + (hi - lo) / 2;
+        if (!less(b[k - i - 1], a[i])) lo = i + 1; // a[i] is output before b[k-i-1]
+        else hi = i;
+    }
+    return lo;
+}
+
+// Merge the sorted runs a[bounds[r] .. bounds[r+1]) into one sorted array.
+// Runs are merged pairwise in log2(runs) rounds. Each round's output is cut
+// into 'parts' equal slices; co_rank finds where a slice starts in both
+// inputs, so every worker moves exactly its share of the elements with no
+// serial step in between. Stable. Worker p adds its time to
+// (*worker_times_ms)[p].
+template<typename T, typename Less>
+static void merge_runs(vector<T> &a, vector<size_t> bounds, size_t parts, const Less &less, vector<double> *worker_times_ms) {
+    size_t n = a.size();
+    if (bounds.size() <= 2) return;
+    parts = max<size_t>(1, parts);
+    vector<T> b(n);
+    while (bounds.size() > 2) {
+        vector<size_t> next;
+        for (size_t r = 0; r + 1 < bounds.size(); r += 2) next.push_back(bounds[r]);
+        next.push_back(n);
+        run_parts(parts, [&](size_t p) {
+            size_t lo = (n * p) / parts, hi = (n * (p + 1)) / parts;
+            for (size_t r = 0; r + 1 < bounds.size(); r += 2) {
+                size_t s = bounds[r], m = bounds[r + 1], e = r + 2 < bounds.size() ? bounds[r + 2] : m;
+                if (e <= lo || s >= hi) continue;
+                size_t k0 = max(lo, s) - s, k1 = min(hi, e) - s;
+                size_t i0 = co_rank(k0, a.data() + s, m - s, a.data() + m, e - m, less);
+                size_t i1 = co_rank(k1, a.data() + s, m - s, a.data() + m, e - m, less);
+                merge(make_move_iterator(a.begin() + (ptrdiff_t)(s + i0)), make_move_iterator(a.begin() + (ptrdiff_t)(s + i1)),
+                      make_move_iterator(a.begin() + (ptrdiff_t)(m + k0 - i0)), make_move_iterator(a.begin() + (ptrdiff_t)(m + k1 - i1)),
+                      b.begin() + (ptrdiff_t)(s + k0), less);
+            }
+        }, worker_times_ms);
+        a.swap(b);
+        bounds.swap(next);
+    }
 }
 
-void print_student_full(const Student &s) {
-    cout << "Name : " << s.name << "\n";
-    cout << "Roll : " << s.roll << "\n";
-    cout << "Branch: " << s.branch << " | Start Year: " << s.start_year << "\n";
+// ---------------- Sample sort ----------------
+// Alternative to equal index ranges + merge (Q3 with --sample-sort): sort a
+// random sample, take parts-1 evenly spaced splitters from it and route every
+// element to the bucket between two splitters. Worker p owns bucket p, which
+// is exactly one disjoint slice of the output, so the sorted buckets are
+// simply concatenated and no merge is needed. Splitters follow the key
+// distribution, so a skewed branch mix still gives even buckets.
+// 'less' must be a strict total order (break ties on row id) so that equal
+// keys keep their input order. Worker p adds its time to (*worker_times_ms)[p]
+// and, if asked, its bucket size to (*bucket_rows)[p].
+static const size_t SAMPLE_SORT_OVERSAMPLE = 1024; // sample elements per bucket (bucket sizes within a few %)
+static const size_t MIN_ROWS_PER_SAMPLE_BUCKET = 256;
+
+template<typename T, typename Less>
+static void sample_sort(vector<T> &a, size_t parts, const Less &less, vector<double> *worker_times_ms, vector<size_t> *bucket_rows = nullptr) {
+    size_t n = a.size();
+    parts = max<size_t>(1, parts);
+    if (worker_times_ms) worker_times_ms->assign(parts, 0.0);
+    if (bucket_rows) bucket_rows->assign(parts, 0);
+    if (parts == 1 || n < parts * MIN_ROWS_PER_SAMPLE_BUCKET) {
+        auto t0 = Clock::now();
+        sort(a.begin(), a.end(), less);
+        if (worker_times_ms) (*worker_times_ms)[0] += chrono::duration_cast<ms>(Clock::now() - t0).count();
+        if (bucket_rows) (*bucket_rows)[0] = n;
+        return;
+    }
+    mt19937_64 rng(n); // fixed seed: the same input always gets the same buckets
+    vector<T> sample(min(n, parts * SAMPLE_SORT_OVERSAMPLE));
+    for (auto &x : sample) x = a[rng() % n];
+    sort(sample.begin(), sample.end(), less);
+    vector<T> splitter(parts - 1);
+    for (size_t b = 1; b < parts; ++b) splitter[b - 1] = sample[(b * sample.size()) / parts];
+
+    // bucket of every element, counted per input block
+    vector<uint32_t> bucket(n);
+    vector<vector<size_t>> count(parts, vector<size_t>(parts, 0));
+    run_parts(parts, [&](size_t p) {
+        auto &cnt = count[p];
+        for (size_t i = (n * p) / parts; i < (n * (p + 1)) / parts; ++i) {
+            uint32_t b = (uint32_t)(upper_bound(splitter.begin(), splitter.end(), a[i], less) - splitter.begin());
+            bucket[i] = b;
+            ++cnt[b];
+        }
+    }, worker_times_ms);
+
+    // block p writes bucket b after all smaller buckets and after the b's of blocks < p
+    vector<size_t> start(parts + 1, 0);
+    for (size_t b = 0; b < parts; ++b) {
+        start[b + 1] = start[b];
+        for (size_t p = 0; p < parts; ++p) start[b + 1] += count[p][b];
+    }
+    vector<vector<size_t>> off(parts, vector<size_t>(parts));
+    for (size_t b = 0; b < parts; ++b) {
+        size_t o = start[b];
+        for (size_t p = 0; p < parts; ++p) { off[p][b] = o; o += count[p][b]; }
+    }
+    vector<T> out(n);
+    run_parts(parts, [&](size_t p) {
+        auto &o = off[p];
+        for (size_t i = (n * p) / parts; i < (n * (p + 1)) / parts; ++i) out[o[bucket[i]]++] = std::move(a[i]);
+    }, worker_times_ms);
+
+    run_parts(parts, [&](size_t p) {
+        sort(out.begin() + (ptrdiff_t)start[p], out.begin() + (ptrdiff_t)start[p + 1], less);
+    }, worker_times_ms);
+    if (bucket_rows) for (size_t b = 0; b < parts; ++b) (*bucket_rows)[b] = start[b + 1] - start[b];
+    a.swap(out);
+}
+
+// ---------------- Sort specs ----------------
+// A sort spec is a comma separated list of fields, each optionally followed
+// by asc or desc, e.g. "start_year desc, avg_grade desc, name". Fields:
+//   branch, start_year (or year), roll, name,
+//   avg_grade (or avg: mean previous grade; students without grades sort lowest),
+//   num_prev (number of graded courses).
+// Rows that tie on every field keep their file order, so all sort paths
+// (radix, merge, sample sort, cached views) give the same permutation.
+enum class SortField { Branch, Year, Roll, Name, AvgGrade, NumPrev };
+struct SortKey { SortField field; bool desc = false; };
+
+struct SortSpec {
+    vector<SortKey> keys;
+
+    // canonical form ("start_year desc,avg_grade desc,name"), also the sorted view cache key
+    string text() const {
+        static const char *names[] = { "branch", "start_year", "roll", "name", "avg_grade", "num_prev" };
+        string t;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (i) t += ',';
+            t += names[(int)keys[i].field];
+            if (keys[i].desc) t += " desc";
+        }
+        return t;
+    }
+    bool is_default() const { return text() == "branch,start_year,roll"; }
+};
+
+static SortSpec default_sort_spec() {
+    return SortSpec{ { {SortField::Branch}, {SortField::Year}, {SortField::Roll} } };
+}
+
+// Parse 'text' into 'out'. On error 'out' is untouched and 'error' says why.
+static bool parse_sort_spec(string_view text, SortSpec &out, string &error) {
+    static const pair<const char*, SortField> fields[] = {
+        {"branch", SortField::Branch}, {"start_year", SortField::Year}, {"year", SortField::Year},
+        {"roll", SortField::Roll}, {"name", SortField::Name}, {"avg_grade", SortField::AvgGrade},
+        {"avg", SortField::AvgGrade}, {"num_prev", SortField::NumPrev}
+    };
+    SortSpec spec;
+    bool ok = true;
+    size_t start = 0;
+    while (ok && start <= text.size()) {
+        size_t comma = text.find(',', start);
+        string_view item = trim(text.substr(start, comma == string_view::npos ? string_view::npos : comma - start));
+        start = comma == string_view::npos ? text.size() + 1 : comma + 1;
+        if (item.empty()) { error = "empty field in sort spec"; ok = false; break; }
+        size_t sp = item.find_first_of(" \t");
+        string_view word = item.substr(0, sp), dir = sp == string_view::npos ? string_view() : trim(item.substr(sp));
+        SortKey key;
+        bool known = false;
+        for (auto &f : fields) if (word == f.first) { key.field = f.second; known = true; }
+        if (!known) { error = "unknown sort field '" + string(word) + "'"; ok = false; break; }
+        if (dir == "desc") key.desc = true;
+        else if (!dir.empty() && dir != "asc") { error = "expected asc or desc after '" + string(word) + "'"; ok = false; break; }
+        for (auto &k : spec.keys) if (k.field == key.field) { error = "field '" + string(word) + "' given twice"; ok = false; }
+        spec.keys.push_back(key);
+    }
+    if (ok) out = spec;
+    return ok;
+}
+
+static SortSpec sort_spec = default_sort_spec(); // --sort SPEC / menu option 9
+
+// mean previous grade, -1 for students without one
+static double avg_grade(const StudentStore &st, uint32_t i) {
+    size_t b = st.prev_begin(i), e = st.prev_end(i);
+    if (b == e) return -1.0;
+    double a = accumulate(st.prev_grade.begin() + (ptrdiff_t)b, st.prev_grade.begin() + (ptrdiff_t)e, 0.0) / (double)(e - b);
+    return a == a ? a : -1.0; // a "nan" grade must not break the ordering
+}
+
+// Three-way compare of one field, one instantiation per field.
+template<SortField F>
+static int field_cmp(const StudentStore &st, uint32_t a, uint32_t b) {
+    if constexpr (F == SortField::Branch) {
+        uint32_t ra = st.branch_rank[st.branch_id[a]], rb = st.branch_rank[st.branch_id[b]];
+        return (ra > rb) - (ra < rb);
+    } else if constexpr (F == SortField::Year) {
+        return (st.start_year[a] > st.start_year[b]) - (st.start_year[a] < st.start_year[b]);
+    } else if constexpr (F == SortField::Roll) {
+        return roll_less(st, a, b) ? -1 : roll_less(st, b, a) ? 1 : 0;
+    } else if constexpr (F == SortField::Name) {
+        int c = st.name[a].compare(st.name[b]);
+        return (c > 0) - (c < 0);
+    } else if constexpr (F == SortField::AvgGrade) {
+        double x = avg_grade(st, a), y = avg_grade(st, b);
+        return (x > y) - (x < y);
+    } else {
+        size_t x = st.prev_end(a) - st.prev_begin(a), y = st.prev_end(b) - st.prev_begin(b);
+        return (x > y) - (x < y);
+    }
+}
+
+// Row comparator for an arbitrary spec. The field comparators are picked once
+// when the spec is compiled, not looked up per comparison. Ties go to row id.
+struct SpecLess {
+    using FieldCmp = int (*)(const StudentStore&, uint32_t, uint32_t);
+    const StudentStore *st;
+    vector<pair<FieldCmp, bool>> keys; // comparator, descending
+
+    SpecLess(const StudentStore &s, const SortSpec &spec) : st(&s) {
+        for (auto &k : spec.keys) {
+            FieldCmp f = nullptr;
+            switch (k.field) {
+                case SortField::Branch:   f = field_cmp<SortField::Branch>; break;
+                case SortField::Year:     f = field_cmp<SortField::Year>; break;
+                case SortField::Roll:     f = field_cmp<SortField::Roll>; break;
+                case SortField::Name:     f = field_cmp<SortField::Name>; break;
+                case SortField::AvgGrade: f = field_cmp<SortField::AvgGrade>; break;
+                case SortField::NumPrev:  f = field_cmp<SortField::NumPrev>; break;
+            }
+            keys.push_back({ f, k.desc });
+        }
+    }
+    bool operator()(uint32_t a, uint32_t b) const {
+        for (auto &k : keys) {
+            int c = k.first(*st, a, b);
+            if (c) return k.second ? c > 0 : c < 0;
+        }
+        return a < b;
+    }
+};
+
+// The default order compiles straight to student_cmp (ties go to row id).
+struct DefaultLess {
+    const StudentStore *st;
+    bool operator()(uint32_t a, uint32_t b) const {
+        if (student_cmp(*st, a, b)) return true;
+        if (student_cmp(*st, b, a)) return false;
+        return a < b;
+    }
+};
+
+// Call f(less) with the comparator type specialized for 'spec', so the sort
+// templates are instantiated per comparator instead of dispatching per call.
+template<typename F>
+static auto with_row_less(const StudentStore &st, const SortSpec &spec, F &&f) {
+    if (spec.is_default()) return f(DefaultLess{ &st });
+    return f(SpecLess(st, spec));
+}
+
+// ---------------- Packed sort keys ----------------
+// One uint64 per student: every spec field is mapped to an order-preserving
+// dense value (branch rank, start_year - min_year, rank among the distinct
+// rolls / names / average grades in order, course count), flipped for desc,
+// and packed high to low in spec order. key[a] < key[b] exactly when the
+// spec orders a before b, so sorts compare integers only; the default spec
+// packs as  branch rank | start_year - min_year | roll rank. The field widths
+// follow the data; if they do not fit in 64 bits 'packed' is false and
+// callers fall back to the spec comparator (with_row_less).
+struct SortKeys {
+    vector<uint64_t> key;
+    bool packed = false;
+};
+
+// Order rows[0..n) by the text in 'col'. All texts in the group share their
+// first 'depth' bytes. Each level radix sorts on the next 8 bytes (big endian
+// and zero padded, so a shorter text sorts first) and recurses into the runs
+// that still tie; numeric rolls of up to 8 digits are done after one level.
+// Small groups go to std::sort.
+static void sort_text(const Cow::Column<string_view> &col, uint32_t *rows, size_t n, size_t depth, size_t parts) {
+    auto tail_less = [&col, depth](uint32_t a, uint32_t b){ return col[a].substr(depth) < col[b].substr(depth); };
+    if (n < 64) { sort(rows, rows + n, tail_less); return; }
+    vector<KeyRow> a(n);
+    for (size_t i = 0; i < n; ++i) {
+        string_view r = col[rows[i]];
+        uint64_t k = 0;
+        for (size_t j = depth; j < depth + 8; ++j) k = (k << 8) | (j < r.size() ? (unsigned char)r[j] : 0u);
+        a[i] = { k, rows[i] };
+    }
+    radix_sort_pairs(a, parts);
+    for (size_t i = 0; i < n; ++i) rows[i] = a[i].row;
+    for (size_t i = 0, j; i < n; i = j) {
+        for (j = i + 1; j < n && a[j].key == a[i].key; ++j) {}
+        if (j - i < 2) continue;
+        bool longer = false, ragged = false;
+        for (size_t r = i; r < j; ++r) {
+            longer |= col[rows[r]].size() > depth + 8;
+            ragged |= col[rows[r]].size() != col[rows[i]].size();
+        }
+        if (longer) sort_text(col, rows + i, j - i, depth + 8, 1);
+        else if (ragged) sort(rows + i, rows + j, tail_less); // only with NUL bytes in a text
+    }
+}
+
+static int bits_for(uint64_t max_value) { return max_value ? 64 - __builtin_clzll(max_value) : 0; }
+
+// dense rank of every row's text: sort once, equal text shares a rank
+static uint64_t text_ranks(const Cow::Column<string_view> &col, vector<uint64_t> &rank) {
+    size_t n = col.size();
+    vector<uint32_t> rows(n);
+    iota(rows.begin(), rows.end(), 0u);
+    sort_text(col, rows.data(), n, 0, radix_workers(n));
+    rank.assign(n, 0);
+    uint64_t r = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (i && col[rows[i]] != col[rows[i-1]]) ++r;
+        rank[rows[i]] = r;
+    }
+    return r;
+}
+
+static SortKeys build_sort_keys(const StudentStore &st, const SortSpec &spec) {
+    SortKeys k;
+    size_t n = st.size();
+    if (n == 0 || spec.keys.empty()) return k;
+    vector<vector<uint64_t>> value(spec.keys.size());
+    vector<int> bits(spec.keys.size());
+    int total = 0;
+    for (size_t f = 0; f < spec.keys.size(); ++f) {
+        auto &v = value[f];
+        uint64_t max_value = 0;
+        switch (spec.keys[f].field) {
+            case SortField::Branch:
+                v.resize(n);
+                for (size_t i = 0; i < n; ++i) v[i] = st.branch_rank[st.branch_id[i]];
+                max_value = st.branches.size() - 1;
+                break;
+            case SortField::Year: {
+                auto years = minmax_element(st.start_year.begin(), st.start_year.end());
+                int64_t min_year = *years.first;
+                v.resize(n);
+                for (size_t i = 0; i < n; ++i) v[i] = (uint64_t)((int64_t)st.start_year[i] - min_year);
+                max_value = (uint64_t)((int64_t)*years.second - min_year);
+                break;
+            }
+            case SortField::Roll: max_value = text_ranks(st.roll, v); break;
+            case SortField::Name: max_value = text_ranks(st.name, v); break;
+            case SortField::AvgGrade: {
+                vector<double> avg(n);
+                for (size_t i = 0; i < n; ++i) avg[i] = avg_grade(st, (uint32_t)i);
+                vector<double> distinct(avg);
+                sort(distinct.begin(), distinct.end());
+                distinct.erase(unique(distinct.begin(), distinct.end()), distinct.end());
+                v.resize(n);
+                for (size_t i = 0; i < n; ++i) v[i] = (uint64_t)(lower_bound(distinct.begin(), distinct.end(), avg[i]) - distinct.begin());
+                max_value = distinct.size() - 1;
+                break;
+            }
+            case SortField::NumPrev:
+                v.resize(n);
+                for (size_t i = 0; i < n; ++i) { v[i] = st.prev_end(i) - st.prev_begin(i); max_value = max<uint64_t>(max_value, v[i]); }
+                break;
+        }
+        if (spec.keys[f].desc) for (auto &x : v) x = max_value - x;
+        bits[f] = bits_for(max_value);
+        total += bits[f];
+        if (total > 64) return k;
+    }
+    k.key.assign(n, 0);
+    for (size_t f = 0; f < spec.keys.size(); ++f) {
+        if (!bits[f]) continue; // constant field (shifting a uint64 by 64 is undefined)
+        for (size_t i = 0; i < n; ++i) k.key[i] = (k.key[i] << bits[f]) | value[f][i];
+    }
+    k.packed = true;
+    return k;
+}
+
+// ---------------- Sorted view cache ----------------
+// Sorted row permutations of a generation's students, keyed by sort spec. An
+// entry is valid for the load (and registrar edit count) it was built in:
+// asking again with no new rows returns the cached permutation as is, and
+// rows appended since then (which all have higher row ids) are sorted on their
+// own and merged in (merge_runs, stable, so ties keep row order exactly like a
+// full sort). Rows whose grades a registrar edit changed are put back in place
+// the same way, when the view is next read (settle_view()). Only a new load
+// pays for a full sort again. The cache belongs to the menu thread; the
+// background follower never touches it.
+enum class ViewSource { Cached, Merged, Sorted };
+struct SortedView {
+    uint64_t load = 0;  // 0 = never built
+    uint64_t edits = 0;
+    size_t rows = 0;    // students covered by 'perm'
+    vector<uint32_t> perm;
+    vector<uint32_t> moved; // rows edited since 'perm' was ordered (their places in it are stale)
+};
+static map<string, SortedView> sorted_views;
+
+// Put the rows marked as moved back in place: they are taken out of 'perm',
+// sorted on their own and merged back in, O(n + d log d) for d moved rows.
+static void settle_view(const StudentStore &students, const SortSpec &spec, SortedView &v, size_t parts) {
+    vector<uint32_t> &moved = v.moved;
+    if (moved.empty()) return;
+    sort(moved.begin(), moved.end());
+    moved.erase(unique(moved.begin(), moved.end()), moved.end());
+    vector<bool> is_moved(v.perm.size());
+    for (uint32_t r : moved) is_moved[r] = true;
+    v.perm.erase(remove_if(v.perm.begin(), v.perm.end(), [&](uint32_t r) { return is_moved[r]; }), v.perm.end());
+    size_t kept = v.perm.size();
+    with_row_less(students, spec, [&](const auto &less) {
+        sort(moved.begin(), moved.end(), less);
+        v.perm.insert(v.perm.end(), moved.begin(), moved.end());
+        merge_runs(v.perm, vector<size_t>{0, kept, v.perm.size()}, parts, less, nullptr);
+    });
+    moved.clear();
+}
+
+// full_sort() returns a fresh permutation of all rows of 'gen'; it is only
+// called when the cache cannot be reused. 'parts' pool workers merge appended rows.
+template<typename FullSort>
+static const vector<uint32_t>& sorted_view(const Generation &gen, const SortSpec &spec, FullSort full_sort, size_t parts, ViewSource &source) {
+    const StudentStore &students = gen.students;
+    SortedView &v = sorted_views[spec.text()];
+    size_t n = students.size();
+    bool same_data = v.load == gen.load && v.edits == gen.edits;
+    if (same_data) settle_view(students, spec, v, parts);
+    if (same_data && v.rows == n) {
+        source = ViewSource::Cached;
+        return v.perm;
+    }
+    if (same_data && v.rows < n) {
+        size_t old = v.rows;
+        v.perm.resize(n);
+        iota(v.perm.begin() + (ptrdiff_t)old, v.perm.end(), (uint32_t)old);
+        with_row_less(students, spec, [&](const auto &less) {
+            sort(v.perm.begin() + (ptrdiff_t)old, v.perm.end(), less);
+            merge_runs(v.perm, vector<size_t>{0, old, n}, parts, less, nullptr);
+        });
+        source = ViewSource::Merged;
+    } else {
+        v.perm = full_sort();
+        v.moved.clear();
+        source = ViewSource::Sorted;
+    }
+    v.load = gen.load;
+    v.edits = gen.edits;
+    v.rows = n;
+    return v.perm;
+}
+
+// ---------------- Registrar edits ----------------
+// Grade corrections without a reload. A batch of edits is applied to a copy of
+// the current generation, which is published once the batch is done, so a
+// reader never sees half of it. Within the copy each edit patches everything
+// derived from the student's grades:
+//   - the store row (StudentStore::add_prev_to / drop_prev_at),
+//   - the course's postings: one insert or erase in its Postings::List,
+//     O(log n) in the course's postings,
+//   - the bucket bitmaps of the old and the new grade (one container each),
+//   - cached sorted views ordered by avg_grade or num_prev: the row is only
+//     marked as moved, O(1); the view puts its moved rows back in place the
+//     next time it is read (settle_view(), one O(n + d log d) pass for d rows).
+// Views on other fields do not depend on grades and stay valid as they are.
+// The batch's copy of the generation shares everything with it
+// (copy_generation()); the store columns copy the chunks an edit writes to
+// (4096 entries each), so a batch costs O(edits), not O(students). Edits live
+// in memory: saving a snapshot (menu option 7) keeps them, a full reload from
+// the CSV drops them.
+static const size_t NO_SLOT = ~(size_t)0;
+
+static void index_add(Generation &gen, uint32_t c, uint32_t s, double g) {
+    if (isnan(g)) return;
+    if (gen.grade_index.size() <= c) gen.grade_index.resize(c + 1);
+    if (gen.grade_bitmaps.size() < gen.grade_index.size()) gen.grade_bitmaps.resize(gen.grade_index.size());
+    gen.grade_index[c].insert(g, s);
+    gen.grade_bitmaps[c].edit()[grade_bucket(g)].add(s);
+}
+
+// Call after the store row has been changed: the student stays in the bucket
+// bitmap while another attempt at the course still falls into that bucket.
+static void index_remove(Generation &gen, uint32_t c, uint32_t s, double g) {
+    if (isnan(g) || c >= gen.grade_index.size()) return;
+    gen.grade_index[c].erase(g, s);
+    const StudentStore &st = gen.students;
+    size_t b = grade_bucket(g);
+    for (size_t j = st.prev_begin(s); j < st.prev_end(s); ++j)
+        if (st.prev_course[j] == c && !isnan(st.prev_grade[j]) && grade_bucket(st.prev_grade[j]) == b) return;
+    gen.grade_bitmaps[c].edit()[b].remove(s);
+}
+
+// roll -> first row with that roll, built on first use and extended with
+// rows appended since; a new load starts it over (menu thread only)
+struct RollLookup {
+    uint64_t load = 0;
+    size_t rows = 0;
+    unordered_map<string_view, uint32_t> first;
+};
+static RollLookup roll_lookup;
+
+static uint32_t find_student(const Generation &gen, string_view roll) {
+    if (roll_lookup.load != gen.load) { roll_lookup = RollLookup(); roll_lookup.load = gen.load; }
+    for (; roll_lookup.rows < gen.students.size(); ++roll_lookup.rows)
+        roll_lookup.first.emplace(gen.students.roll[roll_lookup.rows], (uint32_t)roll_lookup.rows);
+    auto it = roll_lookup.first.find(roll);
+    return it == roll_lookup.first.end() || it->second >= gen.students.size() ? NO_ID : it->second;
+}
+
+// A course code typed at the menu becomes part of the generation's backing
+// memory, so the dictionary view stays valid in every copy of it.
+static string_view keep_text(Generation &gen, string_view s) {
+    auto text = make_shared<const string>(s);
+    gen.backing.push_back(text);
+    return *text;
+}
+
+// The last attempt of course c in row s (the one an edit applies to).
+static size_t last_attempt(const StudentStore &st, uint32_t s, uint32_t c) {
+    for (size_t k = st.prev_end(s); k-- > st.prev_begin(s); )
+        if (st.prev_course[k] == c) return k;
+    return NO_SLOT;
+}
+
+static bool view_uses_grades(const string &key) {
+    return key.find("avg_grade") != string::npos || key.find("num_prev") != string::npos;
+}
+
+// Complete cached views of 'gen' whose order depends on row s's grades mark s
+// as moved; call before the edit, while the view still matches 'gen'.
+static void views_note_edit(const Generation &gen, uint32_t s) {
+    for (auto &kv : sorted_views) {
+        SortedView &v = kv.second;
+        if (view_uses_grades(kv.first) && v.load == gen.load && v.edits == gen.edits && v.rows == gen.students.size())
+            v.moved.push_back(s);
+    }
+}
+
+// After a batch turned 'base' into 'next': the views that were kept up to
+// date move over to 'next'; grade-ordered views that were not complete
+// (rows appended since they were built) are dropped.
+static void retag_views(const Generation &base, const Generation &next) {
+    for (auto it = sorted_views.begin(); it != sorted_views.end(); ) {
+        SortedView &v = it->second;
+        if (v.load != base.load || v.edits != base.edits) { ++it; continue; }
+        if (view_uses_grades(it->first) && v.rows != base.students.size()) { it = sorted_views.erase(it); continue; }
+        v.edits = next.edits;
+        ++it;
+    }
+}
+
+// Set the grade of student s's last attempt at course c.
+static bool update_grade(Generation &gen, uint32_t s, uint32_t c, double g, string &error) {
+    size_t k = c < gen.students.courses.size() ? last_attempt(gen.students, s, c) : NO_SLOT;
+    if (k == NO_SLOT) { error = "no graded attempt at that course"; return false; }
+    double old = gen.students.prev_grade[k];
+    views_note_edit(gen, s);
+    gen.students.prev_grade.set(k, g);
+    index_remove(gen, c, s, old);
+    index_add(gen, c, s, g);
+    return true;
+}
+
+// Record another graded course for student s; a course code never seen
+// before gets a new dictionary id.
+static bool add_course(Generation &gen, uint32_t s, string_view course, double g, string &error) {
+    StudentStore &st = gen.students;
+    if (course.empty()) { error = "empty course"; return false; }
+    if (st.prev_course.size() >= UINT32_MAX - 1) { error = "course list full"; return false; }
+    uint32_t c = st.courses.find(course);
+    if (c == NO_ID) c = st.courses.intern(keep_text(gen, course));
+    views_note_edit(gen, s);
+    st.add_prev_to(s, c, g);
+    index_add(gen, c, s, g);
+    return true;
+}
+
+// Remove student s's last attempt at course c.
+static bool drop_course(Generation &gen, uint32_t s, uint32_t c, string &error) {
+    size_t k = c < gen.students.courses.size() ? last_attempt(gen.students, s, c) : NO_SLOT;
+    if (k == NO_SLOT) { error = "no graded attempt at that course"; return false; }
+    double old = gen.students.prev_grade[k];
+    views_note_edit(gen, s);
+    gen.students.drop_prev_at(s, k);
+    index_remove(gen, c, s, old);
+    return true;
+}
+
+void print_student_full(const StudentStore &st, size_t i) {
+    cout << "Name : " << st.name[i] << "\n";
+    cout << "Roll : " << st.roll[i] << "\n";
+    cout << "Branch: " << st.branch(i) << " | Start Year: " << st.start_year[i] << "\n";
     cout << "Current courses: ";
-    if (s.current_courses.empty()) cout << "[none]";
-    for (size_t i = 0; i < s.current_courses.size(); ++i) {
-        if (i) cout << "; ";
-        cout << s.current_courses[i];
+    auto cur = st.current(i);
+    if (cur.empty()) cout << "[none]";
+    for (size_t k = 0; k < cur.size(); ++k) {
+        if (k) cout << "; ";
+        cout << st.course(cur[k]);
     }
     cout << "\nPrevious courses (course | grade):\n";
-    for (auto &pg : s.prev_courses) {
-        cout << "  - " << pg.first << " | " << fixed << setprecision(1) << pg.second << "\n";
+    for (size_t k = st.prev_begin(i); k < st.prev_end(i); ++k) {
+        cout << "  - " << st.course(st.prev_course[k]) << " | " << fixed << setprecision(1) << st.prev_grade[k] << "\n";
     }
 }
 
 // helper to detect if roll is numeric-only
-static bool roll_is_numeric(const string &r) {
+static bool roll_is_numeric(string_view r) {
     if (r.empty()) return false;
     for (char c : r) if (!isdigit((unsigned char)c)) return false;
     return true;
@@ -187,6 +2008,8 @@ static bool roll_is_numeric(const string &r) {
 // Replaced export behavior: now Q1 prints up to 4 sample students showing different roll types.
 // No CSV export as requested.
 void action_q1_sample_print() {
+    GenerationPtr gen = current_generation(); // this action's data, whatever is published meanwhile
+    const StudentStore &students = gen->students;
     cout << "\n[Q1] Total students loaded: " << students.size() << "\n\n";
 
     if (students.empty()) {
@@ -203,8 +2026,8 @@ void action_q1_sample_print() {
 
     int first_numeric = -1, first_nonnumeric = -1;
     for (size_t i = 0; i < students.size(); ++i) {
-        if (first_numeric == -1 && roll_is_numeric(students[i].roll)) first_numeric = (int)i;
-        if (first_nonnumeric == -1 && !roll_is_numeric(students[i].roll)) first_nonnumeric = (int)i;
+        if (first_numeric == -1 && roll_is_numeric(students.roll[i])) first_numeric = (int)i;
+        if (first_nonnumeric == -1 && !roll_is_numeric(students.roll[i])) first_nonnumeric = (int)i;
         if (first_numeric != -1 && first_nonnumeric != -1) break;
     }
     if (first_numeric != -1) chosen.push_back(first_numeric);
@@ -221,23 +2044,24 @@ void action_q1_sample_print() {
     cout << "Showing " << chosen.size() << " sample students (no export):\n\n";
 
     for (size_t k = 0; k < chosen.size(); ++k) {
-        const Student &s = students[chosen[k]];
+        size_t s = (size_t)chosen[k];
         cout << "----- Sample Student #" << (k+1) << " -----\n";
-        cout << "Name: " << s.name << "\n";
-        cout << "Roll: " << s.roll;
-        cout << "   (type: " << (roll_is_numeric(s.roll) ? "numeric" : "string") << ")\n";
-        cout << "Branch: " << s.branch << " | Start Year: " << s.start_year << "\n";
+        cout << "Name: " << students.name[s] << "\n";
+        cout << "Roll: " << students.roll[s];
+        cout << "   (type: " << (roll_is_numeric(students.roll[s]) ? "numeric" : "string") << ")\n";
+        cout << "Branch: " << students.branch(s) << " | Start Year: " << students.start_year[s] << "\n";
         cout << "Current courses: ";
-        if (s.current_courses.empty()) cout << "[none]";
-        for (size_t i = 0; i < s.current_courses.size(); ++i) {
+        auto cur = students.current(s);
+        if (cur.empty()) cout << "[none]";
+        for (size_t i = 0; i < cur.size(); ++i) {
             if (i) cout << ", ";
-            cout << s.current_courses[i];
+            cout << students.course(cur[i]);
         }
         cout << "\nPrevious courses with grades:\n";
-        if (s.prev_courses.empty()) cout << "  [none]\n";
+        if (students.prev_begin(s) == students.prev_end(s)) cout << "  [none]\n";
         else {
-            for (auto &p : s.prev_courses) {
-                cout << "  - " << p.first << "  | grade: " << fixed << setprecision(1) << p.second << "\n";
+            for (size_t p = students.prev_begin(s); p < students.prev_end(s); ++p) {
+                cout << "  - " << students.course(students.prev_course[p]) << "  | grade: " << fixed << setprecision(1) << students.prev_grade[p] << "\n";
             }
         }
         cout << "-------------------------------\n\n";
@@ -261,13 +2085,15 @@ static void build_reverse_map() {
 }
 
 // helper: token numeric?
-static bool token_is_numeric(const string &t) {
+static bool token_is_numeric(string_view t) {
     if (t.empty()) return false;
     for (char c : t) if (!isdigit((unsigned char)c)) return false;
     return true;
 }
 
 void action_q2_mapping_and_export() {
+    GenerationPtr gen = current_generation(); // this action's data, whatever is published meanwhile
+    const StudentStore &students = gen->students;
     build_reverse_map();
     cout << "\n[Q2] IIT↔IIIT Mapping Sample (show students mapped across systems)\n";
     cout << "Default mapping size: " << iit2iiit.size() << "\n";
@@ -279,7 +2105,7 @@ void action_q2_mapping_and_export() {
             cout << "> " << flush;
             string line;
             if (!getline(cin, line)) break;
-            line = trim(line);
+            line = string(trim(line));
             if (line.empty()) break;
             stringstream ss(line);
             int iit; string iiit;
@@ -290,14 +2116,37 @@ void action_q2_mapping_and_export() {
         }
     }
 
-    struct MapRecord {
-        size_t student_idx;
-        string name;
-        string roll;
-        string branch;
+    // Resolve each distinct course id once against the mapping tables; the scan
+    // over all students below is then one array lookup per course occurrence.
+    struct CourseMapping {
+        bool mapped = false;
         string direction; // "IIIT->IIT" or "IIT->IIIT"
-        string from;      // as in CSV
         string to;        // mapping
+    };
+    vector<CourseMapping> course_map(students.courses.size());
+    for (uint32_t c = 0; c < course_map.size(); ++c) {
+        string_view tok = trim(students.course(c));
+        if (tok.empty()) continue;
+        CourseMapping &m = course_map[c];
+        if (token_is_numeric(tok)) {
+            int id = 0;
+            if (!FastCSV::parse_int(tok, id)) continue;
+            auto it = iit2iiit.find(id);
+            if (it != iit2iiit.end()) m = { true, "IIT->IIIT", it->second };
+        } else {
+            auto it2 = iiit2iit.find(string(tok));
+            if (it2 != iiit2iit.end()) m = { true, "IIIT->IIT", to_string(it2->second) };
+        }
+    }
+
+    struct MapRecord {
+        size_t student_idx;
+        string_view name;
+        string_view roll;
+        string_view branch;
+        string_view direction; // from course_map
+        string_view from; // as in CSV
+        string_view to;
         double grade;     // -1 if not prev
         bool is_prev;
     };
@@ -305,43 +2154,17 @@ void action_q2_mapping_and_export() {
     vector<MapRecord> all_mapped;
 
     for (size_t i = 0; i < students.size(); ++i) {
-        const Student &s = students[i];
+        string_view name = students.name[i], roll = students.roll[i], branch = students.branch(i);
         // current courses
-        for (auto &c : s.current_courses) {
-            string tok = trim(c);
-            if (tok.empty()) continue;
-            if (token_is_numeric(tok)) {
-                int id = 0;
-                try { id = stoi(tok); } catch(...) { continue; }
-                auto it = iit2iiit.find(id);
-                if (it != iit2iiit.end()) {
-                    all_mapped.push_back({i, s.name, s.roll, s.branch, "IIT->IIIT", tok, it->second, -1.0, false});
-                }
-            } else {
-                auto it2 = iiit2iit.find(tok);
-                if (it2 != iiit2iit.end()) {
-                    all_mapped.push_back({i, s.name, s.roll, s.branch, "IIIT->IIT", tok, to_string(it2->second), -1.0, false});
-                }
-            }
+        for (uint32_t c : students.current(i)) {
+            const CourseMapping &m = course_map[c];
+            if (m.mapped) all_mapped.push_back({i, name, roll, branch, m.direction, trim(students.course(c)), m.to, -1.0, false});
         }
         // previous courses
-        for (auto &p : s.prev_courses) {
-            string tok = trim(p.first);
-            double g = p.second;
-            if (tok.empty()) continue;
-            if (token_is_numeric(tok)) {
-                int id = 0;
-                try { id = stoi(tok); } catch(...) { continue; }
-                auto it = iit2iiit.find(id);
-                if (it != iit2iiit.end()) {
-                    all_mapped.push_back({i, s.name, s.roll, s.branch, "IIT->IIIT", tok, it->second, g, true});
-                }
-            } else {
-                auto it2 = iiit2iit.find(tok);
-                if (it2 != iiit2iit.end()) {
-                    all_mapped.push_back({i, s.name, s.roll, s.branch, "IIIT->IIT", tok, to_string(it2->second), g, true});
-                }
-            }
+        for (size_t p = students.prev_begin(i); p < students.prev_end(i); ++p) {
+            uint32_t c = students.prev_course[p];
+            const CourseMapping &m = course_map[c];
+            if (m.mapped) all_mapped.push_back({i, name, roll, branch, m.direction, trim(students.course(c)), m.to, students.prev_grade[p], true});
         }
     }
 
@@ -363,8 +2186,8 @@ void action_q2_mapping_and_export() {
 
     cout << "\n--- Sample mapped students (showing up to " << SAMPLE << ") ---\n\n";
     for (auto si : sample_student_indices) {
-        const Student &s = students[si];
-        cout << "Student: " << s.name << "  |  Roll: " << s.roll << "  | Branch: " << s.branch << " | Year: " << s.start_year << "\n";
+        cout << "Student: " << students.name[si] << "  |  Roll: " << students.roll[si] << "  | Branch: " << students.branch(si)
+             << " | Year: " << students.start_year[si] << "\n";
         // print all mapping occurrences for this student
         for (auto &rec : all_mapped) {
             if (rec.student_idx != si) continue;
@@ -394,46 +2217,329 @@ void action_q2_mapping_and_export() {
 }
 
 // Q3: parallel sort + per-worker timings; option to export full sorted CSV
-void parallel_sort_workers(vector<Student> &arr, int workers, vector<double> &worker_times_ms) {
+// The store itself is never copied or moved: the workers sort a uint32_t row
+// permutation (4 bytes per student) and the export walks the store through
+// it. With packed keys the workers run the parallel radix sort (histogram +
+// scatter per pass, see radix_sort_rows). Otherwise each worker sorts one
+// slice of the permutation and the slices are merged in parallel
+// (merge_runs). With --sample-sort the rows are bucketed by sampled
+// splitters instead (sample_sort) and each worker sorts one bucket; the
+// bucket sizes are printed next to the worker times. The order is the
+// current sort spec (--sort / option 9, default branch, start_year, roll). Worker times include
+// each worker's share of the merge or bucketing.
+static bool q3_sample_sort = false; // --sample-sort
+
+vector<uint32_t> parallel_sort_rows(const StudentStore &st, const SortSpec &spec, int workers, vector<double> &worker_times_ms, vector<size_t> *bucket_rows = nullptr) {
     if (workers < 1) workers = 1;
-    size_t n = arr.size();
-    if (n <= 1) return;
-    vector<size_t> starts(workers), ends(workers);
-    for (int i=0;i<workers;++i){ starts[i] = (n*i)/workers; ends[i] = (n*(i+1))/workers; }
-    worker_times_ms.assign(workers, 0.0);
-    vector<unique_ptr<ThreadWrapper>> th(workers);
-    for (int i=0;i<workers;++i) th[i] = make_unique<ThreadWrapper>();
-    MutexWrapper mtx;
-    for (int i=0;i<workers;++i) {
-        size_t s = starts[i], e = ends[i];
-        th[i]->start([i,s,e,&arr,&worker_times_ms,&mtx](){
-            auto t0 = Clock::now();
-            sort(arr.begin() + (ptrdiff_t)s, arr.begin() + (ptrdiff_t)e, student_cmp);
-            auto t1 = Clock::now();
-            double dur = chrono::duration_cast<ms>(t1 - t0).count();
-            LockGuard lg(mtx);
-            worker_times_ms[i] = dur;
-        });
+    size_t n = st.size();
+    vector<uint32_t> perm(n);
+    iota(perm.begin(), perm.end(), 0u);
+    if (n <= 1) return perm;
+    SortKeys keys = build_sort_keys(st, spec);
+    if (q3_sample_sort && keys.packed) {
+        vector<KeyRow> rows(n);
+        for (size_t i = 0; i < n; ++i) rows[i] = { keys.key[i], (uint32_t)i };
+        sample_sort(rows, (size_t)workers, [](const KeyRow &a, const KeyRow &b) {
+            return a.key != b.key ? a.key < b.key : a.row < b.row;
+        }, &worker_times_ms, bucket_rows);
+        for (size_t i = 0; i < n; ++i) perm[i] = rows[i].row;
+        return perm;
+    }
+    if (keys.packed) return radix_sort_rows(keys.key, (size_t)workers, &worker_times_ms);
+    with_row_less(st, spec, [&](const auto &less) {
+        if (q3_sample_sort) {
+            sample_sort(perm, (size_t)workers, less, &worker_times_ms, bucket_rows);
+            return;
+        }
+        vector<size_t> bounds(workers + 1);
+        for (int i=0;i<=workers;++i) bounds[i] = (n*i)/workers;
+        worker_times_ms.assign(workers, 0.0);
+        run_parts((size_t)workers, [&](size_t i) {
+            sort(perm.begin() + (ptrdiff_t)bounds[i], perm.begin() + (ptrdiff_t)bounds[i + 1], less);
+        }, &worker_times_ms);
+        merge_runs(perm, bounds, (size_t)workers, less, &worker_times_ms);
+    });
+    return perm;
+}
+
+// one students_sorted_q3.csv row (same shape as the input CSV)
+static void write_q3_row(ostream &os, const StudentStore &st, size_t s) {
+    os << "\"" << st.name[s] << "\"," << "\"" << st.roll[s] << "\"," << st.branch(s) << "," << st.start_year[s] << ",";
+    auto cur = st.current(s);
+    for (size_t i=0;i<cur.size();++i){ if (i) os << ";"; os << st.course(cur[i]); }
+    os << ",";
+    for (size_t k=st.prev_begin(s);k<st.prev_end(s);++k){ if (k!=st.prev_begin(s)) os << ";"; os << st.course(st.prev_course[k]) << "|" << st.prev_grade[k]; }
+    os << "\n";
+}
+
+// ---------------- External merge sort ----------------
+// Out-of-core Q3 (--sort-memory MB): sorts the CSV into
+// students_sorted_q3.csv holding one run of rows at a time, so the file can be
+// larger than memory.
+//  1. The CSV is read again through one buffer of about a quarter of the
+//     budget (the run's columns + sort scratch take roughly 3-4x its text),
+//     up to the byte the loaded data reflects: rows appended but not yet
+//     ingested and a last line still being written are left out, as the
+//     load leaves them out. Each buffer's complete rows are one run; a row cut
+//     by the buffer's end starts the next one.
+//  2. Each run is parsed into a scratch store, sorted by the pool workers
+//     (parallel_sort_rows) and spilled to a run file as fixed key fields +
+//     the formatted output row, then the store is dropped.
+//  3. The run files are k-way merged through small read buffers that share
+//     the budget. Ties go to the earlier run, and rows inside a run keep row
+//     order, so the output equals the in-memory Q3 export byte for byte.
+// Registrar edits exist only in memory, so once a generation has some (or
+// when the file no longer starts with the bytes that were loaded) the runs
+// are copied out of the loaded rows instead (StudentStore::slice), cut to
+// about a quarter of the budget of formatted text, estimated from a sample.
+// Spill records: RunRecordHead, then name, roll, branch and the row text.
+static size_t external_sort_budget_mb = 0; // 0 = sort in memory
+static const size_t MIN_EXTERNAL_RUN_BYTES = 1 << 16;
+static const size_t EXTERNAL_SAMPLE_ROWS = 1024; // rows formatted to estimate the text per row
+
+// The rows of a CSV up to byte 'end' (just past a newline), a buffer at a
+// time (pread). A row cut by the end of the buffer is moved to its front by
+// the next call and finished there; a row longer than the buffer doubles it.
+// A run points into the buffer (and 'copies'), so it must be done with before
+// the next call.
+struct CsvBatches {
+    int fd = -1;
+    uint64_t at = 0, end = 0;
+    string buf;
+    size_t rest_at = 0, rest_len = 0; // unparsed bytes left after the last run
+    bool past_header = false;
+    Backing copies;                   // fields copied to drop inner quotes
+    FastCSV::ParseStats stats;
+
+    CsvBatches() = default;
+    CsvBatches(const CsvBatches&) = delete;
+    CsvBatches& operator=(const CsvBatches&) = delete;
+    ~CsvBatches() { if (fd >= 0) close(fd); }
+
+    bool open(const string &filename, uint64_t end_offset, size_t batch) {
+        fd = ::open(filename.c_str(), O_RDONLY);
+        end = end_offset;
+        buf.assign(batch, '\0');
+        return fd >= 0;
+    }
+
+    // the next run of complete rows into 'run' (empty); false after the last
+    bool next(StudentStore &run) {
+        memmove(&buf[0], buf.data() + rest_at, rest_len);
+        size_t held = rest_len;
+        rest_at = rest_len = 0;
+        for (;;) {
+            if (held == buf.size()) buf.resize(buf.size() * 2);
+            size_t want = (size_t)min<uint64_t>(buf.size() - held, end - at), got = 0;
+            while (got < want) {
+                ssize_t r = pread(fd, &buf[held + got], want - got, (off_t)(at + got));
+                if (r <= 0) break;
+                got += (size_t)r;
+            }
+            at += got;
+            string_view text(buf.data(), held + got);
+            size_t skip = 0;
+            if (!past_header) {
+                size_t nl = text.find('\n');
+                if (nl != string_view::npos) { past_header = true; skip = nl + 1; }
+            }
+            size_t last_nl = text.rfind('\n');
+            if (!past_header || last_nl == string_view::npos || last_nl < skip) {
+                if (!got) return false; // nothing complete is left
+                held = text.size() - skip;
+                memmove(&buf[0], text.data() + skip, held);
+                continue;
+            }
+            rest_at = last_nl + 1;
+            rest_len = text.size() - rest_at;
+            copies = Backing();
+            parse_body(text.substr(skip, last_nl + 1 - skip), run, stats, copies);
+            return true;
+        }
+    }
+};
+
+struct RunRecordHead {
+    int32_t start_year;
+    uint32_t num_prev;
+    double avg_grade;
+    uint32_t name_len, roll_len, branch_len, line_len;
+};
+
+// The merge side of a run file: the current record and its key fields.
+struct RunReader {
+    ifstream in;
+    RunRecordHead head{};
+    string buf;
+    string_view name, roll, branch, line;
+    bool valid = false;
+
+    bool next() {
+        valid = false;
+        if (!in.read(reinterpret_cast<char*>(&head), sizeof head)) return false;
+        size_t len = (size_t)head.name_len + head.roll_len + head.branch_len + head.line_len;
+        buf.resize(len);
+        if (!in.read(&buf[0], (streamsize)len)) return false;
+        string_view v(buf);
+        name = v.substr(0, head.name_len);
+        roll = v.substr(head.name_len, head.roll_len);
+        branch = v.substr(head.name_len + head.roll_len, head.branch_len);
+        line = v.substr(head.name_len + head.roll_len + head.branch_len);
+        return valid = true;
+    }
+};
+
+// spec order on the spilled key fields (same results as field_cmp)
+static bool run_record_less(const SortSpec &spec, const RunReader &a, const RunReader &b) {
+    for (auto &k : spec.keys) {
+        int c = 0;
+        switch (k.field) {
+            case SortField::Branch: c = a.branch.compare(b.branch); break;
+            case SortField::Year: c = (a.head.start_year > b.head.start_year) - (a.head.start_year < b.head.start_year); break;
+            case SortField::Roll: c = a.roll.compare(b.roll); break;
+            case SortField::Name: c = a.name.compare(b.name); break;
+            case SortField::AvgGrade: c = (a.head.avg_grade > b.head.avg_grade) - (a.head.avg_grade < b.head.avg_grade); break;
+            case SortField::NumPrev: c = (a.head.num_prev > b.head.num_prev) - (a.head.num_prev < b.head.num_prev); break;
+        }
+        if (c) return k.desc ? c > 0 : c < 0;
+    }
+    return false;
+}
+
+// Fills 'run' (empty) with the next run in row order; false once there is none.
+using RunSource = function<bool(StudentStore&)>;
+
+static bool external_sort(const RunSource &next_run, const string &outfile, size_t budget_bytes, const SortSpec &spec, int workers) {
+    auto t0 = Clock::now();
+    vector<double> worker_ms(workers, 0.0);
+    double read_ms = 0, spill_ms = 0;
+    size_t rows = 0;
+    vector<string> run_files;
+    for (;;) {
+        auto p0 = Clock::now();
+        StudentStore run;
+        if (!next_run(run)) break;
+        read_ms += chrono::duration_cast<ms>(Clock::now() - p0).count();
+        if (run.empty()) continue;
+        vector<double> times;
+        vector<uint32_t> order = parallel_sort_rows(run, spec, workers, times);
+        for (size_t w = 0; w < times.size() && w < worker_ms.size(); ++w) worker_ms[w] += times[w];
+        auto s0 = Clock::now();
+        run_files.push_back(outfile + ".run" + to_string(run_files.size()));
+        // rows are formatted by the pool in blocks, then written out in order
+        size_t parts = fork_parts(order.size(), MIN_ROWS_PER_EXPORT_WORKER);
+        vector<string> text(parts);
+        vector<vector<size_t>> row_end(parts);
+        run_parts(parts, [&](size_t p) {
+            ostringstream os;
+            for (size_t k = (order.size() * p) / parts; k < (order.size() * (p + 1)) / parts; ++k) {
+                write_q3_row(os, run, order[k]);
+                row_end[p].push_back((size_t)os.tellp());
+            }
+            text[p] = std::move(os).str();
+        }, nullptr);
+        ofstream out(run_files.back(), ios::binary | ios::trunc);
+        for (size_t p = 0, k = 0; p < parts; ++p) {
+            size_t begin = 0;
+            for (size_t end : row_end[p]) {
+                uint32_t i = order[k++];
+                string_view br = run.branch(i);
+                RunRecordHead h{ run.start_year[i], (uint32_t)(run.prev_end(i) - run.prev_begin(i)), avg_grade(run, i),
+                                 (uint32_t)run.name[i].size(), (uint32_t)run.roll[i].size(), (uint32_t)br.size(), (uint32_t)(end - begin) };
+                out.write(reinterpret_cast<const char*>(&h), sizeof h);
+                out.write(run.name[i].data(), (streamsize)run.name[i].size());
+                out.write(run.roll[i].data(), (streamsize)run.roll[i].size());
+                out.write(br.data(), (streamsize)br.size());
+                out.write(text[p].data() + begin, (streamsize)(end - begin));
+                begin = end;
+            }
+        }
+        rows += run.size();
+        if (!out) { cout << "Spill to " << run_files.back() << " failed.\n"; for (auto &f : run_files) remove(f.c_str()); return false; }
+        spill_ms += chrono::duration_cast<ms>(Clock::now() - s0).count();
+    }
+
+    // streaming k-way merge; every reader gets an equal slice of the budget
+    auto m0 = Clock::now();
+    size_t buf_bytes = max<size_t>(1 << 16, budget_bytes / (run_files.size() + 1));
+    vector<vector<char>> bufs(run_files.size(), vector<char>(buf_bytes));
+    vector<RunReader> readers(run_files.size());
+    for (size_t r = 0; r < readers.size(); ++r) {
+        readers[r].in.rdbuf()->pubsetbuf(bufs[r].data(), (streamsize)buf_bytes);
+        readers[r].in.open(run_files[r], ios::binary);
+        readers[r].next();
+    }
+    ofstream fout(outfile);
+    fout << "name,roll,branch,start_year,current_courses,previous_courses_with_grades\n";
+    auto after = [&spec, &readers](size_t a, size_t b) { // heap order: smallest record, then lowest run
+        if (run_record_less(spec, readers[b], readers[a])) return true;
+        if (run_record_less(spec, readers[a], readers[b])) return false;
+        return a > b;
+    };
+    priority_queue<size_t, vector<size_t>, decltype(after)> heap(after);
+    for (size_t r = 0; r < readers.size(); ++r) if (readers[r].valid) heap.push(r);
+    while (!heap.empty()) {
+        size_t r = heap.top(); heap.pop();
+        fout.write(readers[r].line.data(), (streamsize)readers[r].line.size());
+        if (readers[r].next()) heap.push(r);
     }
-    for (int i=0;i<workers;++i) th[i]->join();
-    // k-way merge
-    vector<Student> aux; aux.reserve(n);
-    struct Item { const Student* s; int part; size_t idx; };
-    struct Cmp { bool operator()(const Item &a, const Item &b) const { return student_cmp(*b.s, *a.s); } };
-    priority_queue<Item, vector<Item>, Cmp> pq;
-    vector<size_t> pos(workers);
-    for (int p=0;p<workers;++p) {
-        if (starts[p] < ends[p]) { pq.push(Item{ &arr[starts[p]], p, starts[p] }); pos[p] = starts[p]; }
-        else pos[p] = ends[p];
+    fout.close();
+    readers.clear();
+    for (auto &f : run_files) remove(f.c_str());
+    double merge_ms = chrono::duration_cast<ms>(Clock::now() - m0).count();
+    double total = chrono::duration_cast<ms>(Clock::now() - t0).count();
+
+    cout << "Total wall time: " << total << " ms (" << rows << " students)\n";
+    cout << " Read runs: " << read_ms << " ms\n";
+    for (size_t w = 0; w < worker_ms.size(); ++w) cout << " Worker " << w << " time: " << worker_ms[w] << " ms\n";
+    cout << " Spill " << run_files.size() << " run(s): " << spill_ms << " ms\n";
+    cout << " Merge: " << merge_ms << " ms\n";
+    cout << "Exported " << outfile << "\n";
+    return true;
+}
+
+// Q3 with --sort-memory: the runs are read from the CSV when it holds exactly
+// the current generation's rows, else copied from the loaded rows.
+static void action_q3_external(int workers) {
+    size_t budget = external_sort_budget_mb << 20;
+    GenerationPtr gen;
+    uint64_t end = 0;
+    bool from_csv = false;
+    {
+        LockGuard writer(index_mtx); // the published generation and csv_tail agree while it is held
+        gen = current_generation();
+        struct stat st;
+        from_csv = gen->edits == 0 && stat(CSV_FILE.c_str(), &st) == 0 && csv_tail_holds(CSV_FILE, st);
+        end = csv_tail.offset;
     }
-    while (!pq.empty()) {
-        auto it = pq.top(); pq.pop();
-        aux.push_back(*it.s);
-        int p = it.part;
-        pos[p]++;
-        if (pos[p] < ends[p]) pq.push(Item{ &arr[pos[p]], p, pos[p] });
+    const StudentStore &students = gen->students;
+    RunSource source;
+    CsvBatches csv;
+    size_t n = students.size(), next_row = 0, run_rows = 0;
+    if (from_csv && csv.open(CSV_FILE, end, max(MIN_EXTERNAL_RUN_BYTES, budget / 4))) {
+        cout << "External sort of " << CSV_FILE << " (" << end << " bytes) within " << (budget >> 20) << " MB: runs of "
+             << (csv.buf.size() >> 10) << " KB of rows with " << workers << " workers...\n" << flush;
+        source = [&csv](StudentStore &run) { return csv.next(run); };
+    } else {
+        cout << (gen->edits ? "NOTE: registrar edits exist only in memory"
+                            : "NOTE: " + CSV_FILE + " no longer starts with the loaded rows")
+             << "; the runs are copied from the " << students.size() << " loaded students.\n";
+        ostringstream sample;
+        size_t sampled = min(n, EXTERNAL_SAMPLE_ROWS);
+        for (size_t i = 0; i < sampled; ++i) write_q3_row(sample, students, i);
+        size_t row_bytes = sampled ? max<size_t>(1, (size_t)sample.tellp() / sampled) : 1;
+        run_rows = max<size_t>(1, max(MIN_EXTERNAL_RUN_BYTES, budget / 4) / row_bytes);
+        cout << "External sort of " << n << " students within " << (budget >> 20) << " MB: "
+             << (n + run_rows - 1) / run_rows << " run(s) with " << workers << " workers...\n" << flush;
+        source = [&](StudentStore &run) {
+            if (next_row >= n) return false;
+            run = StudentStore::slice(students, next_row, min(n, next_row + run_rows));
+            next_row += run_rows;
+            return true;
+        };
     }
-    for (size_t i=0;i<n;++i) arr[i] = move(aux[i]);
+    if (external_sort(source, "students_sorted_q3.csv", budget, sort_spec, workers) && csv.fd >= 0 && csv.at != end)
+        cout << "NOTE: " << CSV_FILE << " shrank while it was read; the rows past byte " << csv.at << " are missing.\n";
 }
 
 void action_q3_parallel_and_export() {
@@ -442,129 +2548,393 @@ void action_q3_parallel_and_export() {
     if (!(cin >> workers)) { cin.clear(); workers = 2; }
     string rest; getline(cin, rest);
     if (workers < 2) workers = 2;
-    cout << "Sorting with " << workers << " workers...\n" << flush;
-    vector<Student> arr = students; // copy
+    if (!sort_spec.is_default()) cout << "Sort order: " << sort_spec.text() << "\n";
+    if (external_sort_budget_mb) {
+        action_q3_external(workers);
+        return;
+    }
+    GenerationPtr gen = current_generation(); // this action's data, whatever is published meanwhile
+    const StudentStore &students = gen->students;
+
+    cout << "Sorting with " << workers << " workers" << (q3_sample_sort ? " (sample sort)" : "") << "...\n" << flush;
     vector<double> times_ms;
+    vector<size_t> bucket_rows;
+    ViewSource source;
     auto t0 = Clock::now();
-    parallel_sort_workers(arr, workers, times_ms);
+    const vector<uint32_t> &order = sorted_view(*gen, sort_spec, [&]() {
+        return parallel_sort_rows(students, sort_spec, workers, times_ms, &bucket_rows);
+    }, (size_t)workers, source);
     auto t1 = Clock::now();
     double total = chrono::duration_cast<ms>(t1 - t0).count();
     cout << "Total wall time: " << total << " ms\n";
-    for (int i=0;i<(int)times_ms.size();++i) cout << " Worker " << i << " time: " << times_ms[i] << " ms\n";
+    if (source == ViewSource::Cached) cout << "Data unchanged since the last sort: reused the cached sorted view.\n";
+    else if (source == ViewSource::Merged) cout << "Merged the newly appended students into the cached sorted view.\n";
+    for (int i=0;i<(int)times_ms.size();++i) {
+        cout << " Worker " << i << " time: " << times_ms[i] << " ms";
+        if (i < (int)bucket_rows.size()) cout << " (" << bucket_rows[i] << " rows)";
+        cout << "\n";
+    }
     cout << "Export full sorted CSV? (y/N): " << flush;
     string r; getline(cin >> ws, r);
     if (!r.empty() && (r[0]=='y' || r[0]=='Y')) {
         ofstream fout("students_sorted_q3.csv");
         fout << "name,roll,branch,start_year,current_courses,previous_courses_with_grades\n";
-        for (auto &s : arr) {
-            fout << "\"" << s.name << "\"," << "\"" << s.roll << "\"," << s.branch << "," << s.start_year << ",";
-            for (size_t i=0;i<s.current_courses.size();++i){ if (i) fout << ";"; fout << s.current_courses[i]; }
-            fout << ",";
-            for (size_t i=0;i<s.prev_courses.size();++i){ if (i) fout << ";"; fout << s.prev_courses[i].first << "|" << s.prev_courses[i].second; }
-            fout << "\n";
-        }
+        export_rows(fout, order.size(), [&](ostream &os, size_t r) { write_q3_row(os, students, order[r]); });
         fout.close();
         cout << "Exported students_sorted_q3.csv\n";
     }
 }
 
 // Q4: iterator views without copying entire Student objects; export sorted pointer view if requested
+// ---------------- Top-K and paging ----------------
+// Positions [offset, offset + limit) of a sort order. A current cached view is
+// simply sliced. Otherwise a small page is found by partial selection:
+// nth_element splits the rows at the page start and again at the page end
+// (O(n) each) and only the page itself is sorted, O(n + limit log limit)
+// instead of a full sort. Pages wider than n / PAGE_SELECT_FRACTION build
+// (and cache) the full view instead. from_end counts positions from the last
+// row and returns the page in descending order.
+static const size_t PAGE_SELECT_FRACTION = 8;
+
+static const vector<uint32_t>* current_view(const Generation &gen, const SortSpec &spec) {
+    auto it = sorted_views.find(spec.text());
+    if (it == sorted_views.end()) return nullptr;
+    SortedView &v = it->second;
+    if (v.load != gen.load || v.edits != gen.edits || v.rows != gen.students.size()) return nullptr;
+    settle_view(gen.students, spec, v, radix_workers(v.rows));
+    return &v.perm;
+}
+
+static vector<uint32_t> sorted_page(const Generation &gen, const SortSpec &spec, size_t offset, size_t limit, bool from_end = false) {
+    const StudentStore &students = gen.students;
+    size_t n = students.size();
+    if (offset >= n || limit == 0) return {};
+    limit = min(limit, n - offset);
+    size_t lo = from_end ? n - offset - limit : offset, hi = lo + limit; // ascending positions
+    vector<uint32_t> page;
+    const vector<uint32_t> *view = current_view(gen, spec);
+    if (!view && limit > n / PAGE_SELECT_FRACTION) {
+        ViewSource source;
+        view = &sorted_view(gen, spec, [&]() {
+            vector<double> times_ms;
+            return parallel_sort_rows(students, spec, (int)radix_workers(students.size()), times_ms);
+        }, radix_workers(n), source);
+    }
+    if (view) {
+        page.assign(view->begin() + (ptrdiff_t)lo, view->begin() + (ptrdiff_t)hi);
+    } else {
+        vector<uint32_t> rows(n);
+        iota(rows.begin(), rows.end(), 0u);
+        with_row_less(students, spec, [&](const auto &less) {
+            if (lo > 0) nth_element(rows.begin(), rows.begin() + (ptrdiff_t)lo, rows.end(), less);
+            if (hi < n) nth_element(rows.begin() + (ptrdiff_t)lo, rows.begin() + (ptrdiff_t)hi, rows.end(), less);
+            sort(rows.begin() + (ptrdiff_t)lo, rows.begin() + (ptrdiff_t)hi, less);
+        });
+        page.assign(rows.begin() + (ptrdiff_t)lo, rows.begin() + (ptrdiff_t)hi);
+    }
+    if (from_end) reverse(page.begin(), page.end());
+    return page;
+}
+
 void action_q4_iterators_and_export() {
+    GenerationPtr gen = current_generation(); // this action's data, whatever is published meanwhile
+    const StudentStore &students = gen->students;
     cout << "\n[Q4] Views using iterators (no full-data copy)\n";
     cout << "First 5 in entered order:\n";
     for (size_t i=0;i<min<size_t>(5, students.size()); ++i) {
-        cout << " " << (i+1) << ". "; print_student_full(students[i]); cout << "\n";
-    }
-    // build index vector (vector<size_t> acts like pointer view)
-    vector<size_t> idxs(students.size());
-    iota(idxs.begin(), idxs.end(), 0);
-    sort(idxs.begin(), idxs.end(), [](size_t a, size_t b){
-        const Student &A = students[a], &B = students[b];
-        if (A.branch != B.branch) return A.branch < B.branch;
-        if (A.start_year != B.start_year) return A.start_year < B.start_year;
-        return A.roll < B.roll;
-    });
+        cout << " " << (i+1) << ". "; print_student_full(students, i); cout << "\n";
+    }
+    // only the 5 + 5 rows shown are selected (sorted_page); the full index
+    // vector is built (or taken from the Q3/Q4 view cache) for the export only
+    vector<uint32_t> first = sorted_page(*gen, sort_spec, 0, 5), last = sorted_page(*gen, sort_spec, 0, 5, true);
+    if (!sort_spec.is_default()) cout << "\nSort order: " << sort_spec.text() << "\n";
     cout << "\nFirst 5 in sorted ascending (using index iterator):\n";
-    for (size_t i=0;i<min<size_t>(5, idxs.size()); ++i) {
-        cout << " " << (i+1) << ". "; print_student_full(students[idxs[i]]); cout << "\n";
+    for (size_t i=0;i<first.size(); ++i) {
+        cout << " " << (i+1) << ". "; print_student_full(students, first[i]); cout << "\n";
     }
     cout << "\nFirst 5 in sorted descending (using reverse_iterator):\n";
-    for (size_t i=0;i<min<size_t>(5, idxs.size()); ++i) {
-        cout << " " << (i+1) << ". "; print_student_full(students[idxs[idxs.size()-1-i]]); cout << "\n";
+    for (size_t i=0;i<last.size(); ++i) {
+        cout << " " << (i+1) << ". "; print_student_full(students, last[i]); cout << "\n";
     }
     cout << "Export sorted view to students_sorted_menu.csv? (y/N): " << flush;
     string r; getline(cin >> ws, r);
     if (!r.empty() && (r[0]=='y' || r[0]=='Y')) {
+        ViewSource source;
+        const vector<uint32_t> &idxs = sorted_view(*gen, sort_spec, [&]() {
+            vector<double> times_ms;
+            return parallel_sort_rows(students, sort_spec, (int)radix_workers(students.size()), times_ms);
+        }, radix_workers(students.size()), source);
         ofstream fout("students_sorted_menu.csv");
         fout << "name,roll,branch,start_year,avg_prev_grade,num_prev_courses\n";
-        for (auto id : idxs) {
-            auto &s = students[id];
-            vector<double> grades;
-            for (auto &p : s.prev_courses) grades.push_back(p.second);
+        export_rows(fout, idxs.size(), [&](ostream &os, size_t r) {
+            size_t id = idxs[r];
+            auto g0 = students.prev_grade.begin() + (ptrdiff_t)students.prev_begin(id);
+            auto g1 = students.prev_grade.begin() + (ptrdiff_t)students.prev_end(id);
+            size_t count = (size_t)(g1 - g0);
             string avg = "";
-            if (!grades.empty()) {
-                double a = accumulate(grades.begin(), grades.end(), 0.0) / grades.size();
+            if (count) {
+                double a = accumulate(g0, g1, 0.0) / count;
                 avg = to_string((double)round(a*100)/100.0);
             }
-            fout << "\"" << s.name << "\"," << "\"" << s.roll << "\"," << s.branch << "," << s.start_year << "," << avg << "," << grades.size() << "\n";
-        }
+            os << "\"" << students.name[id] << "\"," << "\"" << students.roll[id] << "\"," << students.branch(id) << "," << students.start_year[id] << "," << avg << "," << count << "\n";
+        });
         fout.close();
         cout << "Exported students_sorted_menu.csv\n";
     }
 }
 
-// Q5: query index for students with grade >= 9.0; also export all high-grade students
+// Q5: grade queries on grade_index for any threshold or range; also export
+// every student at or above a grade (default 9.0)
+
+// "9.0", "7.5", "8.25": at least one decimal, without touching cout's format
+static string grade_text(double g) {
+    ostringstream os;
+    if (round(g * 10) == g * 10) os << fixed << setprecision(1);
+    os << g;
+    return os.str();
+}
+
+// Boolean query over courses, evaluated left to right on the bucket bitmaps:
+//   TERM { (AND | OR | NOT) TERM } [>= X]
+// TERM is a course id, optionally with its own bound (ML>=8). "A NOT B" means
+// A and not B. A trailing ">= X" sets the bound of terms without one (9.0).
+static bool eval_course_query(const Generation &gen, const string &line, Roaring::Bitmap &out, string &error) {
+    vector<string> words;
+    istringstream in(line);
+    for (string w; in >> w; ) words.push_back(w);
+    double def = HIGH_GRADE;
+    size_t n = words.size();
+    if (n >= 2 && words[n-2] == ">=") {
+        if (!FastCSV::parse_grade(words[n-1], def)) { error = "bad grade '" + words[n-1] + "'"; return false; }
+        n -= 2;
+    } else if (n >= 1 && words[n-1].rfind(">=", 0) == 0) {
+        if (!FastCSV::parse_grade(string_view(words[n-1]).substr(2), def)) { error = "bad grade '" + words[n-1] + "'"; return false; }
+        n -= 1;
+    }
+    auto upper = [](string w) { for (auto &ch : w) ch = (char)toupper((unsigned char)ch); return w; };
+    auto term = [&](const string &w, Roaring::Bitmap &bm) {
+        double x = def;
+        size_t ge = w.find(">=");
+        string course = w.substr(0, ge);
+        if (ge != string::npos && !FastCSV::parse_grade(string_view(w).substr(ge + 2), x)) { error = "bad grade in '" + w + "'"; return false; }
+        uint32_t c = gen.students.courses.find(course);
+        if (course.empty() || c >= gen.grade_bitmaps.size()) { error = "unknown course '" + course + "'"; return false; }
+        bm = students_at_least(gen, c, x);
+        return true;
+    };
+    if (n == 0 || n % 2 == 0) { error = "expected COURSE { AND|OR|NOT COURSE } [>= GRADE]"; return false; }
+    if (!term(words[0], out)) return false;
+    for (size_t i = 1; i < n; i += 2) {
+        string op = upper(words[i]);
+        Roaring::Bitmap rhs;
+        if (op != "AND" && op != "OR" && op != "NOT") { error = "expected AND, OR or NOT instead of '" + words[i] + "'"; return false; }
+        if (!term(words[i+1], rhs)) return false;
+        if (op == "AND") out &= rhs;
+        else if (op == "OR") out |= rhs;
+        else out = and_not(out, rhs);
+    }
+    return true;
+}
+
 void action_q5_query_and_export() {
-    cout << "\n[Q5] Fast queries for students with grade >= 9.0\n";
-    cout << "1) Interactive query for a course\n2) Export all high-grade students to high_grade_students.csv\nChoice (1/2, default 1): " << flush;
+    GenerationPtr gen = current_generation(); // this action's data, whatever is published meanwhile
+    const StudentStore &students = gen->students;
+    const vector<List> &grade_index = gen->grade_index;
+    cout << "\n[Q5] Fast grade queries per course (default: grade >= " << grade_text(HIGH_GRADE) << ")\n";
+    cout << "1) Interactive query for a course\n2) Export all high-grade students to high_grade_students.csv (optionally: 2 MIN_GRADE)\n"
+         << "3) Count students at or above a grade in every course (3 MIN_GRADE)\n"
+         << "4) Combine courses, e.g. ML AND DSA NOT OS >= 9 (AND / OR / NOT, COURSE>=X per course)\n"
+         << "Choice (1/2/3/4, default 1): " << flush;
     string ch; getline(cin >> ws, ch);
-    if (ch.empty()) ch = "1";
-    if (ch == "2") {
+    istringstream chin(ch);
+    string choice, word;
+    chin >> choice;
+    if (choice.empty()) choice = "1";
+    double lo = HIGH_GRADE;
+    if ((choice == "2" || choice == "3") && chin >> word && !FastCSV::parse_grade(word, lo)) { cout << "Bad grade '" << word << "'\n"; return; }
+    if (choice == "4") {
+        cout << "Query: " << flush;
+        string line;
+        if (!getline(cin >> ws, line)) { cout << "No input\n"; return; }
+        auto t0 = Clock::now();
+        Roaring::Bitmap hits;
+        string error;
+        if (!eval_course_query(*gen, line, hits, error)) { cout << "Bad query: " << error << "\n"; return; }
+        double dur = chrono::duration_cast<ms>(Clock::now() - t0).count();
+        cout << "Matched " << hits.cardinality() << " students (" << dur << " ms), showing up to 50:\n";
+        size_t shown = 0;
+        hits.for_each([&](uint32_t idx) {
+            if (shown++ < 50) cout << " - " << students.name[idx] << " | " << students.roll[idx] << " | " << students.branch(idx) << "\n";
+        });
+        return;
+    }
+    if (choice == "3") {
+        cout << "Students with grade >= " << grade_text(lo) << " per course:\n";
+        for (uint32_t c = 0; c < grade_index.size(); ++c)
+            cout << "  " << students.course(c) << ": " << grade_count(*gen, c, lo) << "\n";
+    } else if (choice == "2") {
+        // output rows [row_start[c], row_start[c + 1]) are the matching postings of course c
+        vector<size_t> row_start(grade_index.size() + 1, 0);
+        vector<double> grade;
+        vector<uint32_t> student;
+        for (uint32_t c = 0; c < grade_index.size(); ++c) {
+            auto r = grade_range(*gen, c, lo);
+            grade_index[c].for_each(r.first, r.second, [&](double pg, uint32_t ps) { grade.push_back(pg); student.push_back(ps); });
+            row_start[c + 1] = student.size();
+        }
         ofstream fout("high_grade_students.csv");
         fout << "course,name,roll,branch,start_year,grade\n";
-        for (auto &kv : high_grade_index) {
-            string course = kv.first;
-            for (auto idx : kv.second) {
-                const Student &s = students[idx];
-                double grade = -1;
-                for (auto &p : s.prev_courses) if (trim(p.first) == course) { grade = p.second; break; }
-                fout << "\"" << course << "\"," << "\"" << s.name << "\"," << "\"" << s.roll << "\"," << s.branch << "," << s.start_year << "," << grade << "\n";
-            }
-        }
+        export_rows(fout, row_start.back(), [&](ostream &os, size_t r) {
+            size_t c = (size_t)(upper_bound(row_start.begin(), row_start.end(), r) - row_start.begin()) - 1;
+            uint32_t idx = student[r];
+            os << "\"" << students.course((uint32_t)c) << "\"," << "\"" << students.name[idx] << "\"," << "\"" << students.roll[idx] << "\"," << students.branch(idx) << "," << students.start_year[idx] << "," << grade[r] << "\n";
+        });
         fout.close();
         cout << "Exported high_grade_students.csv\n";
     } else {
-        cout << "Enter course id (e.g. OOPS or 110): " << flush;
+        cout << "Enter course id, optionally with a grade or range (e.g. OOPS, 110 8, OOPS 7.5 8.5): " << flush;
+        string line;
+        if (!getline(cin >> ws, line)) { cout << "No input\n"; return; }
+        // trailing numbers are the grade bounds, the rest is the course id
+        vector<string> words;
+        istringstream in(line);
+        while (in >> word) words.push_back(word);
+        double bound[2];
+        size_t nums = 0;
+        while (nums < 2 && words.size() > 1 && FastCSV::parse_grade(words.back(), bound[1 - nums])) { words.pop_back(); ++nums; }
+        double hi = numeric_limits<double>::infinity();
+        if (nums == 1) lo = bound[1];
+        if (nums == 2) { lo = bound[0]; hi = bound[1]; }
+        if (lo > hi) swap(lo, hi);
         string course;
-        if (!getline(cin >> ws, course)) { cout << "No input\n"; return; }
-        course = trim(course);
+        for (auto &w : words) course += (course.empty() ? "" : " ") + w;
         if (course.empty()) { cout << "Empty\n"; return; }
-        auto it = high_grade_index.find(course);
-        if (it == high_grade_index.end() || it->second.empty()) {
-            cout << "No students with grade >=9.0 for '" << course << "'\n";
+        string range = nums == 2 ? "in [" + grade_text(lo) + ", " + grade_text(hi) + "]" : ">=" + grade_text(lo);
+        uint32_t c = students.courses.find(course);
+        auto r = grade_range(*gen, c, lo, hi);
+        size_t found = r.second - r.first;
+        if (!found) {
+            cout << "No students with grade " << range << " for '" << course << "'\n";
             return;
         }
-        cout << "Found " << it->second.size() << " students (showing up to 50):\n";
-        size_t shown = 0;
-        for (auto idx : it->second) {
-            auto &s = students[idx];
-            double grade = -1;
-            for (auto &p : s.prev_courses) if (trim(p.first) == course) { grade = p.second; break; }
-            cout << " - " << s.name << " | " << s.roll << " | " << s.branch << " | grade: " << grade << "\n";
-            if (++shown >= 50) break;
-        }
+        cout << "Found " << found << " students (showing up to 50):\n";
+        grade_index[c].for_each(r.first, min(r.second, r.first + 50), [&](double pg, uint32_t idx) {
+            cout << " - " << students.name[idx] << " | " << students.roll[idx] << " | " << students.branch(idx) << " | grade: " << pg << "\n";
+        });
     }
 }
 
 // ---------------- Menu & main ----------------
+void action_set_sort_order() {
+    cout << "\nSort order for Q3/Q4, comma separated, each field optionally followed by asc/desc.\n"
+         << "Fields: branch, start_year (year), roll, name, avg_grade (avg), num_prev\n"
+         << "e.g. start_year desc, avg_grade desc, name   (Enter = branch, start_year, roll)\n"
+         << "Sort order: " << flush;
+    string line;
+    if (!getline(cin, line)) return;
+    if (trim(line).empty()) { sort_spec = default_sort_spec(); cout << "Sort order reset to " << sort_spec.text() << ".\n"; return; }
+    string error;
+    if (!parse_sort_spec(line, sort_spec, error)) { cout << "Sort order unchanged: " << error << ".\n"; return; }
+    cout << "Sort order set to " << sort_spec.text() << ".\n";
+}
+
+void action_page_sorted() {
+    GenerationPtr gen = current_generation(); // this action's data, whatever is published meanwhile
+    const StudentStore &students = gen->students;
+    cout << "\nPage of the students in order " << sort_spec.text() << ".\n"
+         << "Enter offset and limit (default 0 20); add 'desc' to count from the end: " << flush;
+    string line;
+    if (!getline(cin, line)) return;
+    istringstream in(line);
+    size_t offset = 0, limit = 20;
+    string word;
+    bool from_end = false;
+    vector<size_t> nums;
+    while (in >> word) {
+        if (word == "desc") { from_end = true; continue; }
+        try { nums.push_back((size_t)stoull(word)); } catch(...) { cout << "Ignoring '" << word << "'\n"; }
+    }
+    if (nums.size() > 0) offset = nums[0];
+    if (nums.size() > 1) limit = nums[1];
+    auto t0 = Clock::now();
+    vector<uint32_t> page = sorted_page(*gen, sort_spec, offset, limit, from_end);
+    double dur = chrono::duration_cast<ms>(Clock::now() - t0).count();
+    for (size_t i = 0; i < page.size(); ++i) {
+        uint32_t r = page[i];
+        cout << " " << (offset + i + 1) << ". " << students.name[r] << " | " << students.roll[r] << " | "
+             << students.branch(r) << " | " << students.start_year[r] << "\n";
+    }
+    cout << page.size() << " of " << students.size() << " students (" << (from_end ? "from the end, " : "") << dur << " ms)\n";
+}
+
+void action_registrar_edit() {
+    cout << "\nRegistrar edits (kept in memory; option 7 saves them in the snapshot, a full reload drops them)\n"
+         << "  update ROLL COURSE GRADE | add ROLL COURSE GRADE | drop ROLL COURSE, several separated by ';'\n"
+         << "Edit: " << flush;
+    string line;
+    if (!getline(cin, line)) return;
+    vector<string> edits;
+    for (size_t start = 0; start <= line.size(); ) {
+        size_t semi = min(line.find(';', start), line.size());
+        string_view e = trim(string_view(line).substr(start, semi - start));
+        if (!e.empty()) edits.emplace_back(e);
+        start = semi + 1;
+    }
+    if (edits.empty()) { cout << "Nothing to do.\n"; return; }
+
+    LockGuard writer(index_mtx);
+    auto t0 = Clock::now();
+    GenerationPtr base = current_generation();
+    shared_ptr<Generation> next = copy_generation(*base);
+    vector<uint32_t> changed;
+    for (const string &e : edits) {
+        istringstream in(e);
+        string op, roll, course, grade_word, extra, error;
+        in >> op >> roll >> course;
+        bool with_grade = op == "update" || op == "add";
+        double g = 0;
+        if ((!with_grade && op != "drop") || course.empty() || (with_grade && !(in >> grade_word)) || in >> extra)
+            error = "expected update ROLL COURSE GRADE | add ROLL COURSE GRADE | drop ROLL COURSE";
+        else if (with_grade && !FastCSV::parse_grade(grade_word, g)) error = "bad grade '" + grade_word + "'";
+        uint32_t s = error.empty() ? find_student(*next, roll) : NO_ID;
+        if (error.empty() && s == NO_ID) error = "no student with roll '" + roll + "'";
+        bool ok = false;
+        if (error.empty()) {
+            if (op == "add") ok = add_course(*next, s, course, g, error);
+            else if (op == "update") ok = update_grade(*next, s, next->students.courses.find(course), g, error);
+            else ok = drop_course(*next, s, next->students.courses.find(course), error);
+        }
+        if (!ok) { cout << "Not changed: " << error << " (" << e << ").\n"; continue; }
+        if (find(changed.begin(), changed.end(), s) == changed.end()) changed.push_back(s);
+    }
+    if (changed.empty()) return;
+    next->edits = base->edits + 1;
+    retag_views(*base, *next);
+    publish(next);
+    double dur = chrono::duration_cast<ms>(Clock::now() - t0).count();
+    const StudentStore &st = next->students;
+    for (uint32_t s : changed) {
+        cout << st.name[s] << " | " << st.roll[s] << " | previous:";
+        for (size_t k = st.prev_begin(s); k < st.prev_end(s); ++k) cout << " " << st.course(st.prev_course[k]) << "|" << st.prev_grade[k];
+        cout << "\n";
+    }
+    cout << "Published in " << dur << " ms.\n";
+}
+
 void show_menu() {
+    print_follower_notes();
     cout << "\n===== ERP Menu (Q1 - Q5) =====\n";
     cout << "1) Q1: Show sample students (3-4) with roll types, courses & grades (no export)\n";
     cout << "2) Q2: Show sample students mapped across IIT<->IIIT systems (view + optional export)\n";
     cout << "3) Q3: Parallel sort (per-worker times) and export sorted CSV\n";
     cout << "4) Q4: Entered/sorted views using iterators (no copying) and export\n";
-    cout << "5) Q5: Fast query / export students with grade >= 9.0\n";
-    cout << "6) Reload CSV\n";
+    cout << "5) Q5: Fast grade query (any threshold or range) / export high-grade students\n";
+    cout << "6) Reload CSV (only parses appended rows when the file just grew)\n";
+    cout << "7) Save binary snapshot (" << SNAP_FILE << ") for instant startup\n";
+    cout << "8) Follow CSV appends (inotify tail mode" << (following() ? "; running, 8 stops it" : "") << ")\n";
+    cout << "9) Set the sort order used by Q3/Q4 (current: " << sort_spec.text() << ")\n";
+    cout << "10) Page through the students in sort order\n";
+    cout << "11) Registrar edits: update / add / drop students' course grades\n";
     cout << "0) Exit\n";
     cout << "Enter choice: " << flush;
 }
@@ -572,15 +2942,45 @@ void show_menu() {
 int main(int argc, char** argv) {
     ios::sync_with_stdio(false);
     cin.tie(nullptr);
+#if defined(USE_STD_THREAD) || defined(USE_POSIX)
+    WorkPool::Pool::instance(); // start the workers once, before any menu action
+#endif
+
+    load_workers = default_load_workers();
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--load-workers" && i + 1 < argc) {
+            try { load_workers = max(1, stoi(argv[++i])); } catch(...) { load_workers = 1; }
+        } else if (arg == "--sort" && i + 1 < argc) {
+            string error;
+            if (!parse_sort_spec(argv[++i], sort_spec, error)) { cerr << "Bad --sort: " << error << "\n"; return 2; }
+        } else if (arg == "--sort-memory" && i + 1 < argc) {
+            try { external_sort_budget_mb = (size_t)max(1, stoi(argv[++i])); } catch(...) { external_sort_budget_mb = 0; }
+        } else if (arg == "--sample-sort") {
+            q3_sample_sort = true;
+        } else if (arg == "--csv" && i + 1 < argc) {
+            CSV_FILE = argv[++i];
+            size_t dot = CSV_FILE.rfind('.');
+            SNAP_FILE = (dot == string::npos || CSV_FILE.find('/', dot) != string::npos ? CSV_FILE : CSV_FILE.substr(0, dot)) + ".snap";
+        }
+    }
 
     cout << "ERP Menu (integrated Q1..Q5) starting...\n" << flush;
 
-    if (!load_csv("students_3000.csv")) {
-        cerr << "Failed to load students_3000.csv. Place it in working directory and retry.\n";
+    bool loaded;
+    {
+        LockGuard writer(index_mtx);
+        loaded = load_data();
+    }
+    if (!loaded) {
+        cerr << "Failed to load " << CSV_FILE << ". Place it in working directory and retry.\n";
         return 1;
     }
     build_reverse_map(); // build iiit2iit mapping from default iit2iiit
-    cout << "Loaded " << students.size() << " students.\n" << flush;
+    GenerationPtr first = current_generation();
+    cout << "Loaded " << first->students.size() << " students" << (first->from_snapshot ? " (from snapshot)" : "") << ".\n" << flush;
+    cout << rejected_fields_text(first->load_stats);
+    first.reset();
 
     while (true) {
         show_menu();
@@ -595,14 +2995,19 @@ int main(int argc, char** argv) {
         else if (choice == "5") action_q5_query_and_export();
         else if (choice == "6") {
             cout << "Reloading CSV...\n";
-            if (load_csv("students_3000.csv")) cout << "Reloaded " << students.size() << " students.\n";
-            else cout << "Reload failed.\n";
-        } else {
+            cout << reload_csv();
+        } else if (choice == "7") action_save_snapshot();
+        else if (choice == "8") action_follow_csv();
+        else if (choice == "9") action_set_sort_order();
+        else if (choice == "10") action_page_sorted();
+        else if (choice == "11") action_registrar_edit();
+        else {
             cout << "Unknown option '" << choice << "'. Try again.\n";
         }
         cout << "\n(press Enter to continue...) " << flush;
         string dummy; getline(cin, dummy);
     }
 
+    stop_following();
     return 0;
 }
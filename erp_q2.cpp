@@ -10,61 +10,42 @@
 // Expects students_3000.csv in current directory.
 
 #include <bits/stdc++.h>
+#include "fastcsv.h"
 using namespace std;
 
 // ---------- CSV parsing helpers ----------
-static inline string trim(const string &s) {
-    size_t a = 0;
-    while (a < s.size() && isspace((unsigned char)s[a])) ++a;
-    size_t b = s.size();
-    while (b > a && isspace((unsigned char)s[b-1])) --b;
-    return s.substr(a, b-a);
-}
+// Fields are string_views into the memory-mapped CSV (see fastcsv.h).
+using FastCSV::trim;
 
-static vector<string> split_csv_line(const string &line, char delim=',') {
-    vector<string> out;
-    string cur;
-    bool inq = false;
-    for (char c : line) {
-        if (c == '"') { inq = !inq; continue; } // drop quotes
-        if (c == delim && !inq) { out.push_back(cur); cur.clear(); }
-        else cur.push_back(c);
-    }
-    out.push_back(cur);
+static vector<string_view> split_semis(string_view s) {
+    vector<string_view> out;
+    out.reserve(count(s.begin(), s.end(), ';') + 1);
+    FastCSV::for_each_semi(s, [&](string_view tok){ out.push_back(tok); });
     return out;
 }
 
-static vector<string> split_semis(const string &s) {
-    vector<string> out; string cur;
-    for (char c : s) {
-        if (c == ';') { out.push_back(trim(cur)); cur.clear(); }
-        else cur.push_back(c);
-    }
-    if (!cur.empty()) out.push_back(trim(cur));
-    return out;
-}
+static FastCSV::ParseStats parse_stats; // junk grades / years (kept as 0)
 
-static vector<pair<string,double>> parse_prev(const string &s) {
-    vector<pair<string,double>> out;
-    for (auto &p : split_semis(s)) {
-        auto pos = p.find('|');
-        if (pos == string::npos) continue;
-        string code = trim(p.substr(0,pos));
-        double grade = 0.0;
-        try { grade = stod(trim(p.substr(pos+1))); } catch(...) {}
+static vector<pair<string_view,double>> parse_prev(string_view s) {
+    vector<pair<string_view,double>> out;
+    out.reserve(count(s.begin(), s.end(), ';') + 1);
+    FastCSV::for_each_prev(s, [&](string_view code, string_view gradeS){
+        double grade;
+        if (!FastCSV::parse_grade(gradeS, grade)) ++parse_stats.bad_grades;
         out.emplace_back(code, grade);
-    }
+    });
     return out;
 }
 
 // ---------- Student struct ----------
+// Text fields point into the mapped CSV, which stays open for the whole run.
 struct Student {
-    string name;
-    string roll;
-    string branch;
+    string_view name;
+    string_view roll;
+    string_view branch;
     int start_year = 0;
-    vector<string> current_courses;
-    vector<pair<string,double>> prev_courses;
+    vector<string_view> current_courses;
+    vector<pair<string_view,double>> prev_courses;
 };
 
 // ---------- default mapping (IIT int -> IIIT string) ----------
@@ -76,7 +57,7 @@ static unordered_map<int,string> default_iit2iiit() {
 }
 
 // determine whether token is numeric (pure digits)
-static bool is_numeric_token(const string &t) {
+static bool is_numeric_token(string_view t) {
     if (t.empty()) return false;
     for (char c : t) if (!isdigit((unsigned char)c)) return false;
     return true;
@@ -88,36 +69,34 @@ int main() {
     cin.tie(nullptr);
 
     const string csvfile = "students_3000.csv";
-    ifstream fin(csvfile);
-    if (!fin) {
+    FastCSV::MappedFile csv(csvfile); // must outlive 'students'
+    FastCSV::Unquoted unquoted; // fields copied to drop inner quotes (must outlive 'students' too)
+    if (!csv.is_open()) {
         cerr << "ERROR: cannot open " << csvfile << ". Place it in working dir.\n";
         return 1;
     }
 
     // read CSV
-    string header;
-    getline(fin, header);
+    string_view rest = csv.view(), line;
+    FastCSV::next_line(rest, line); // header
     vector<Student> students;
-    string line;
-    while (getline(fin, line)) {
+    string_view cols[6];
+    while (FastCSV::next_line(rest, line)) {
         if (trim(line).empty()) continue;
-        auto cols = split_csv_line(line);
-        if (cols.size() < 6) continue;
+        if (FastCSV::split_fields(line, cols, 6, unquoted) < 6) continue;
         Student s;
         s.name = trim(cols[0]);
-        string roll = cols[1];
-        if (!roll.empty() && roll.front()=='"') roll = roll.substr(1);
-        if (!roll.empty() && roll.back()=='"')  roll.pop_back();
-        s.roll = trim(roll);
+        s.roll = trim(cols[1]);
         s.branch = trim(cols[2]);
-        try { s.start_year = stoi(trim(cols[3])); } catch(...) { s.start_year = 0; }
+        if (!FastCSV::parse_int(trim(cols[3]), s.start_year)) ++parse_stats.bad_years;
         s.current_courses = split_semis(cols[4]);
         s.prev_courses = parse_prev(cols[5]);
         students.push_back(move(s));
     }
-    fin.close();
 
     cout << "Loaded " << students.size() << " students from " << csvfile << ".\n";
+    if (parse_stats.rejected())
+        cout << "Rejected fields: " << parse_stats.bad_grades << " grade(s), " << parse_stats.bad_years << " start year(s).\n";
 
     // build mapping
     auto iit2iiit = default_iit2iiit();
@@ -127,10 +106,10 @@ int main() {
     // collect mapped records: for each student, record any mapping occurrences
     struct MapRecord {
         size_t student_idx;
-        string student_name;
-        string student_roll;
+        string_view student_name;
+        string_view student_roll;
         string mapping_direction; // "IIIT->IIT" or "IIT->IIIT"
-        string course_from;       // as in CSV
+        string_view course_from;  // as in CSV
         string course_to;         // mapped counterpart
         double grade;             // for prev-course mapping (or -1)
         bool is_prev;
@@ -143,19 +122,19 @@ int main() {
 
         // current courses
         for (auto &c : s.current_courses) {
-            string tok = trim(c);
+            string_view tok = trim(c);
             if (tok.empty()) continue;
             if (is_numeric_token(tok)) {
                 // numeric token => IIT course; see if maps to IIIT
                 int id = 0;
-                try { id = stoi(tok); } catch(...) { continue; }
+                if (!FastCSV::parse_int(tok, id)) continue;
                 auto it = iit2iiit.find(id);
                 if (it != iit2iiit.end()) {
                     mapped.push_back({i, s.name, s.roll, "IIT->IIIT", tok, it->second, -1.0, false});
                 }
             } else {
                 // string token => IIIT course; see if maps to IIT
-                auto it2 = iiit2iit.find(tok);
+                auto it2 = iiit2iit.find(string(tok));
                 if (it2 != iiit2iit.end()) {
                     mapped.push_back({i, s.name, s.roll, "IIIT->IIT", tok, to_string(it2->second), -1.0, false});
                 }
@@ -164,18 +143,18 @@ int main() {
 
         // previous courses (with grades)
         for (auto &p : s.prev_courses) {
-            string tok = trim(p.first);
+            string_view tok = trim(p.first);
             double grade = p.second;
             if (tok.empty()) continue;
             if (is_numeric_token(tok)) {
                 int id = 0;
-                try { id = stoi(tok); } catch(...) { continue; }
+                if (!FastCSV::parse_int(tok, id)) continue;
                 auto it = iit2iiit.find(id);
                 if (it != iit2iiit.end()) {
                     mapped.push_back({i, s.name, s.roll, "IIT->IIIT", tok, it->second, grade, true});
                 }
             } else {
-                auto it2 = iiit2iit.find(tok);
+                auto it2 = iiit2iit.find(string(tok));
                 if (it2 != iiit2iit.end()) {
                     mapped.push_back({i, s.name, s.roll, "IIIT->IIT", tok, to_string(it2->second), grade, true});
                 }
@@ -23,6 +23,8 @@
 //
 
 #include <bits/stdc++.h>
+#include "fastcsv.h"
+#include "workpool.h"
 using namespace std;
 using Clock = chrono::high_resolution_clock;
 using ms = chrono::duration<double, milli>;
@@ -38,16 +40,6 @@ using ms = chrono::duration<double, milli>;
   // C++ standard threading
   #include <thread>
   #include <mutex>
-  struct ThreadWrapper {
-    using Task = function<void()>;
-    ThreadWrapper() = default;
-    template<typename F>
-    void start(F&& f) { thr = std::thread(std::forward<F>(f)); started = true; }
-    void join() { if (started && thr.joinable()) thr.join(); started = false; }
-  private:
-    std::thread thr;
-    bool started = false;
-  };
   using MutexWrapper = std::mutex;
   struct LockGuard { explicit LockGuard(MutexWrapper &m):m(m){ m.lock(); } ~LockGuard(){ m.unlock(); } private: MutexWrapper &m; };
 
@@ -67,27 +59,22 @@ using ms = chrono::duration<double, milli>;
   };
   struct LockGuard { explicit LockGuard(MutexWrapper &m):mref(m){ mref.lock(); } ~LockGuard(){ mref.unlock(); } private: MutexWrapper &mref; };
 
+#endif
+
+#if defined(USE_STD_THREAD) || defined(USE_POSIX)
+
+  // Both real backends hand tasks to the persistent work-stealing pool in
+  // workpool.h (started once in main) instead of creating a thread per start().
+  // join() waits for the task and rethrows anything it threw.
   struct ThreadWrapper {
     using Task = function<void()>;
-    ThreadWrapper():started(false) {}
+    ThreadWrapper() = default;
     template<typename F>
-    void start(F&& f) {
-        // heap-allocate function object and pass to pthread_create
-        auto fn = new Task(std::forward<F>(f));
-        int rc = pthread_create(&thr, nullptr, &ThreadWrapper::entry, fn);
-        if (rc != 0) { delete fn; throw runtime_error("pthread_create failed"); }
-        started = true;
-    }
-    void join(){ if (started) { pthread_join(thr, nullptr); started = false; } }
-    static void* entry(void* arg){
-        Task* task = static_cast<Task*>(arg);
-        try { (*task)(); } catch(...) { /* swallow */ }
-        delete task;
-        return nullptr;
-    }
+    void start(F&& f) { job = WorkPool::Pool::instance().fork(Task(std::forward<F>(f))); }
+    void join() { if (job) { auto j = std::move(job); job = nullptr; WorkPool::Pool::instance().join(j); } }
+    ~ThreadWrapper() { if (job) { try { join(); } catch(...) {} } }
   private:
-    pthread_t thr;
-    bool started;
+    WorkPool::JobPtr job;
   };
 
 #else
@@ -117,52 +104,34 @@ using ms = chrono::duration<double, milli>;
 // course lists semicolon-separated; previous courses are "course|grade" semicolon-separated.
 // ------------------------
 struct Student {
-    string name;
-    string roll;
-    string branch;
+    string_view name;
+    string_view roll;
+    string_view branch;
     int start_year = 0;
-    vector<string> current_courses;
-    vector<pair<string,double>> prev_courses;
+    vector<string_view> current_courses;
+    vector<pair<string_view,double>> prev_courses;
 };
 
 // CSV helpers
-static inline string trim(const string &s) {
-    size_t a = 0; while (a < s.size() && isspace((unsigned char)s[a])) ++a;
-    size_t b = s.size(); while (b > a && isspace((unsigned char)s[b-1])) --b;
-    return s.substr(a, b-a);
-}
-static inline vector<string> split_csv_line(const string &line, char delim=',') {
-    vector<string> out; string cur; bool inquotes=false;
-    for (size_t i=0;i<line.size();++i){
-        char c=line[i];
-        if (c=='"') { inquotes = !inquotes; continue; }
-        if (c==delim && !inquotes) { out.push_back(cur); cur.clear(); }
-        else cur.push_back(c);
-    }
-    out.push_back(cur);
-    return out;
-}
-static inline vector<string> parse_semis(const string &s) {
-    vector<string> out; string cur;
-    for (char c : s) {
-        if (c == ';') { out.push_back(trim(cur)); cur.clear(); }
-        else cur.push_back(c);
-    }
-    if (!cur.empty()) out.push_back(trim(cur));
+using FastCSV::trim;
+
+static inline vector<string_view> parse_semis(string_view s) {
+    vector<string_view> out;
+    out.reserve(count(s.begin(), s.end(), ';') + 1);
+    FastCSV::for_each_semi(s, [&](string_view tok){ out.push_back(tok); });
     return out;
 }
-static inline vector<pair<string,double>> parse_prev(const string &s) {
-    vector<pair<string,double>> out;
-    auto parts = parse_semis(s);
-    for (auto &p : parts) {
-        auto pos = p.find('|');
-        if (pos == string::npos) continue;
-        string code = trim(p.substr(0,pos));
-        string gradeS = trim(p.substr(pos+1));
-        double g = 0.0;
-        try { g = stod(gradeS); } catch(...) { g = 0.0; }
+
+static FastCSV::ParseStats parse_stats; // junk grades / years (kept as 0)
+
+static inline vector<pair<string_view,double>> parse_prev(string_view s) {
+    vector<pair<string_view,double>> out;
+    out.reserve(count(s.begin(), s.end(), ';') + 1);
+    FastCSV::for_each_prev(s, [&](string_view code, string_view gradeS){
+        double g;
+        if (!FastCSV::parse_grade(gradeS, g)) ++parse_stats.bad_grades;
         out.emplace_back(code, g);
-    }
+    });
     return out;
 }
 
@@ -174,9 +143,39 @@ bool student_cmp(const Student &a, const Student &b) {
 }
 
 // ------------------------
-// Parallel sorting: split into N parts, sort each part in a worker thread, measure time per worker, then k-way merge
+// Merge path: the first k outputs of a stable merge of sorted a[0..na) and
+// b[0..nb) are a[0..i) and b[0..k-i) for the i returned here (ties take 'a'
+// first). Binary search, so any slice of a merge can be located directly.
+// ------------------------
+static size_t co_rank(size_t k, const Student *a, size_t na, const Student *b, size_t nb) {
+    size_t lo = k > nb ? k - nb : 0, hi = min(k, na);
+    while (lo < hi) {
+        size_t i = lo + (hi - lo) / 2;
+        if (!student_cmp(b[k - i - 1], a[i])) lo = i + 1; // a[i] is output before b[k-i-1]
+        else hi = i;
+    }
+    return lo;
+}
+
+// Produce out[lo..hi) of one merge round: runs bounds[r]..bounds[r+1] are
+// merged in pairs (a trailing unpaired run is moved as is).
+static void merge_slice(vector<Student> &in, vector<Student> &out, const vector<size_t> &bounds, size_t lo, size_t hi) {
+    for (size_t r = 0; r + 1 < bounds.size(); r += 2) {
+        size_t s = bounds[r], m = bounds[r+1], e = r + 2 < bounds.size() ? bounds[r+2] : m;
+        if (e <= lo || s >= hi) continue;
+        size_t k0 = max(lo, s) - s, k1 = min(hi, e) - s;
+        size_t i0 = co_rank(k0, in.data() + s, m - s, in.data() + m, e - m);
+        size_t i1 = co_rank(k1, in.data() + s, m - s, in.data() + m, e - m);
+        merge(make_move_iterator(in.begin() + (ptrdiff_t)(s + i0)), make_move_iterator(in.begin() + (ptrdiff_t)(s + i1)),
+              make_move_iterator(in.begin() + (ptrdiff_t)(m + k0 - i0)), make_move_iterator(in.begin() + (ptrdiff_t)(m + k1 - i1)),
+              out.begin() + (ptrdiff_t)(s + k0), student_cmp);
+    }
+}
+
+// ------------------------
+// Parallel sorting: split into N parts, sort each part in a worker thread, measure time per worker, then merge in parallel
 // No race conditions: each worker sorts a distinct subrange; writes its timing into a protected array with a mutex.
-// Merge happens after all worker joins.
+// Merge rounds start after all worker joins; each worker's time includes its merge slices.
 // ------------------------
 void parallel_sort(vector<Student> &arr, int workers, vector<double> &worker_times_ms) {
     if (workers < 1) workers = 1;
@@ -220,46 +219,33 @@ void parallel_sort(vector<Student> &arr, int workers, vector<double> &worker_tim
     // Join workers
     for (int i = 0; i < workers; ++i) threads[i]->join();
 
-    // Merge sorted partitions: use k-way merge via min-heap
-    // Each partition is arr[starts[i] .. ends[i]-1]
-    // We'll build iterators for each partition and merge into aux
-    vector<Student> aux;
-    aux.reserve(n);
-
-    // Min-heap element: (Student, partition_index, index_within_partition)
-    struct Item {
-        const Student* s;
-        int part;
-        size_t idx; // absolute index in arr
-    };
-    struct Cmp {
-        bool operator()(const Item &a, const Item &b) const {
-            // want min-heap => return true if a > b
-            return student_cmp(*b.s, *a.s);
-        }
-    };
-    priority_queue<Item, vector<Item>, Cmp> pq;
-    // initialize
-    for (int p = 0; p < workers; ++p) {
-        if (starts[p] < ends[p]) {
-            pq.push(Item{ &arr[starts[p]], p, starts[p] });
+    // Merge sorted partitions pairwise, log2(workers) rounds. Each round's
+    // output is cut into 'workers' equal slices and every worker merges its
+    // slice (merge path, see co_rank), moving records into aux and back.
+    vector<size_t> bounds(starts);
+    bounds.push_back(n);
+    vector<Student> aux(n);
+    while (bounds.size() > 2) {
+        vector<size_t> next;
+        for (size_t r = 0; r + 1 < bounds.size(); r += 2) next.push_back(bounds[r]);
+        next.push_back(n);
+        for (int i = 0; i < workers; ++i) {
+            size_t lo = (n * i) / workers, hi = (n * (i+1)) / workers;
+            auto task = [i, lo, hi, &arr, &aux, &bounds, &worker_times_ms, &log_mtx]() {
+                auto t0 = Clock::now();
+                merge_slice(arr, aux, bounds, lo, hi);
+                double dur = chrono::duration_cast<ms>(Clock::now() - t0).count();
+                {
+                    LockGuard lg(log_mtx);
+                    worker_times_ms[i] += dur;
+                }
+            };
+            threads[i]->start(task);
         }
+        for (int i = 0; i < workers; ++i) threads[i]->join();
+        arr.swap(aux);
+        bounds.swap(next);
     }
-    // track current positions
-    vector<size_t> pos = starts;
-
-    while (!pq.empty()) {
-        auto it = pq.top(); pq.pop();
-        aux.push_back(*it.s);
-        int p = it.part;
-        pos[p]++;
-        if (pos[p] < ends[p]) {
-            pq.push(Item{ &arr[pos[p]], p, pos[p] });
-        }
-    }
-
-    // Move merged result back
-    for (size_t i = 0; i < n; ++i) arr[i] = move(aux[i]);
 }
 
 // ------------------------
@@ -268,43 +254,41 @@ void parallel_sort(vector<Student> &arr, int workers, vector<double> &worker_tim
 int main(int argc, char** argv) {
     ios::sync_with_stdio(false);
     cin.tie(nullptr);
+#if defined(USE_STD_THREAD) || defined(USE_POSIX)
+    WorkPool::Pool::instance(); // start the pool workers once, up front
+#endif
 
     string csvfile = "students_3000.csv";
-    ifstream fin(csvfile);
-    if (!fin) {
+    FastCSV::MappedFile csv(csvfile); // backing memory for every Student field
+    FastCSV::Unquoted unquoted; // fields copied to drop inner quotes (must outlive 'students' too)
+    if (!csv.is_open()) {
         cerr << "ERROR: Could not open " << csvfile << " in current directory.\n";
         cerr << "Please place students_3000.csv in the working folder and run again.\n";
         return 1;
     }
 
-    string header;
-    getline(fin, header); // skip header
+    string_view rest = csv.view(), line;
+    FastCSV::next_line(rest, line); // skip header
 
     vector<Student> students;
     students.reserve(3500);
-    string line;
-    while (getline(fin, line)) {
+    string_view cols[6];
+    while (FastCSV::next_line(rest, line)) {
         if (trim(line).empty()) continue;
-        auto cols = split_csv_line(line);
-        if (cols.size() < 6) continue;
+        if (FastCSV::split_fields(line, cols, 6, unquoted) < 6) continue; // skip malformed
         Student s;
-        string name = cols[0];
-        if (!name.empty() && name.front() == '"') name = name.substr(1);
-        if (!name.empty() && name.back() == '"') name.pop_back();
-        s.name = name;
-        string roll = cols[1];
-        if (!roll.empty() && roll.front() == '"') roll = roll.substr(1);
-        if (!roll.empty() && roll.back() == '"') roll.pop_back();
-        s.roll = trim(roll);
+        s.name = cols[0];
+        s.roll = trim(cols[1]);
         s.branch = trim(cols[2]);
-        try { s.start_year = stoi(trim(cols[3])); } catch(...) { s.start_year = 0; }
+        if (!FastCSV::parse_int(trim(cols[3]), s.start_year)) ++parse_stats.bad_years;
         s.current_courses = parse_semis(cols[4]);
         s.prev_courses = parse_prev(cols[5]);
         students.push_back(move(s));
     }
-    fin.close();
 
     cout << "Loaded " << students.size() << " students from " << csvfile << ".\n";
+    if (parse_stats.rejected())
+        cout << "Rejected fields: " << parse_stats.bad_grades << " grade(s), " << parse_stats.bad_years << " start year(s).\n";
     if (students.empty()) return 1;
 
     // default worker count
@@ -10,62 +10,38 @@
 // The program expects students_3000.csv in the same directory.
 
 #include <bits/stdc++.h>
+#include "fastcsv.h"
 using namespace std;
 
 struct Student {
-    string name;
-    string roll;
-    string branch;
+    string_view name;
+    string_view roll;
+    string_view branch;
     int start_year = 0;
-    vector<string> current_courses;
-    vector<pair<string,double>> prev_courses;
+    vector<string_view> current_courses;
+    vector<pair<string_view,double>> prev_courses;
 };
 
 // --- CSV helpers (robust enough for the generated CSV) ---
-static inline string trim(const string &s) {
-    size_t a = 0;
-    while (a < s.size() && isspace((unsigned char)s[a])) ++a;
-    size_t b = s.size();
-    while (b > a && isspace((unsigned char)s[b-1])) --b;
-    return s.substr(a, b-a);
-}
+using FastCSV::trim;
 
-static inline vector<string> split_csv_line(const string &line, char delim=',') {
-    vector<string> out;
-    string cur;
-    bool inquotes = false;
-    for (size_t i = 0; i < line.size(); ++i) {
-        char c = line[i];
-        if (c == '"') { inquotes = !inquotes; continue; }
-        if (c == delim && !inquotes) { out.push_back(cur); cur.clear(); }
-        else cur.push_back(c);
-    }
-    out.push_back(cur);
+static inline vector<string_view> parse_semis(string_view s) {
+    vector<string_view> out;
+    out.reserve(count(s.begin(), s.end(), ';') + 1);
+    FastCSV::for_each_semi(s, [&](string_view tok){ out.push_back(tok); });
     return out;
 }
 
-static inline vector<string> parse_semis(const string &s) {
-    vector<string> out; string cur;
-    for (char c : s) {
-        if (c == ';') { out.push_back(trim(cur)); cur.clear(); }
-        else cur.push_back(c);
-    }
-    if (!cur.empty()) out.push_back(trim(cur));
-    return out;
-}
+static FastCSV::ParseStats parse_stats; // junk grades / years (kept as 0)
 
-static inline vector<pair<string,double>> parse_prev(const string &s) {
-    vector<pair<string,double>> out;
-    auto parts = parse_semis(s);
-    for (auto &p : parts) {
-        auto pos = p.find('|');
-        if (pos == string::npos) continue;
-        string code = trim(p.substr(0,pos));
-        string gradeS = trim(p.substr(pos+1));
-        double g = 0.0;
-        try { g = stod(gradeS); } catch(...) { g = 0.0; }
+static inline vector<pair<string_view,double>> parse_prev(string_view s) {
+    vector<pair<string_view,double>> out;
+    out.reserve(count(s.begin(), s.end(), ';') + 1);
+    FastCSV::for_each_prev(s, [&](string_view code, string_view gradeS){
+        double g;
+        if (!FastCSV::parse_grade(gradeS, g)) ++parse_stats.bad_grades;
         out.emplace_back(code, g);
-    }
+    });
     return out;
 }
 
@@ -86,47 +62,35 @@ int main() {
     cin.tie(nullptr);
 
     string csvfile = "students_3000.csv";
-    ifstream fin(csvfile);
-    if (!fin) {
+    FastCSV::MappedFile csv(csvfile); // backing memory for every Student field
+    FastCSV::Unquoted unquoted; // fields copied to drop inner quotes (must outlive 'students' too)
+    if (!csv.is_open()) {
         cerr << "ERROR: Cannot open " << csvfile << ". Place it in the working directory.\n";
         return 1;
     }
 
-    // Read header
-    string header;
-    getline(fin, header);
+    string_view rest = csv.view(), line;
+    FastCSV::next_line(rest, line); // skip header
 
-    // Store the actual student records exactly once in a vector.
-    // This is the canonical storage (entered order = push_back order).
     vector<Student> students;
     students.reserve(3100);
-
-    string line;
-    while (getline(fin, line)) {
+    string_view cols[6];
+    while (FastCSV::next_line(rest, line)) {
         if (trim(line).empty()) continue;
-        auto cols = split_csv_line(line);
-        if (cols.size() < 6) continue; // skip malformed
+        if (FastCSV::split_fields(line, cols, 6, unquoted) < 6) continue; // skip malformed
         Student s;
-        string name = cols[0];
-        if (!name.empty() && name.front() == '"') name = name.substr(1);
-        if (!name.empty() && name.back() == '"') name.pop_back();
-        s.name = name;
-
-        string roll = cols[1];
-        if (!roll.empty() && roll.front() == '"') roll = roll.substr(1);
-        if (!roll.empty() && roll.back() == '"') roll.pop_back();
-        s.roll = trim(roll);
-
+        s.name = cols[0];
+        s.roll = trim(cols[1]);
         s.branch = trim(cols[2]);
-        try { s.start_year = stoi(trim(cols[3])); } catch(...) { s.start_year = 0; }
+        if (!FastCSV::parse_int(trim(cols[3]), s.start_year)) ++parse_stats.bad_years;
         s.current_courses = parse_semis(cols[4]);
         s.prev_courses = parse_prev(cols[5]);
-
         students.push_back(move(s));
     }
-    fin.close();
 
     cout << "Loaded " << students.size() << " student records (stored once in memory).\n\n";
+    if (parse_stats.rejected())
+        cout << "Rejected fields: " << parse_stats.bad_grades << " grade(s), " << parse_stats.bad_years << " start year(s).\n";
 
     // ----------------------------
     // 1) Show records in entered order using vector<Student>::const_iterator
@@ -183,12 +147,12 @@ int main() {
     // ----------------------------
     cout << "=== First 20 names from sorted ascending (using ostream_iterator) ===\n";
     // We'll transform pointer vector entries to names via std::transform and use ostream_iterator.
-    vector<string> first20names;
+    vector<string_view> first20names;
     first20names.reserve(20);
     size_t limit = min<size_t>(20, ptrs.size());
     for (size_t i = 0; i < limit; ++i) first20names.push_back(ptrs[i]->name);
     // Use ostream_iterator (output iterator) to stream names separated by newline
-    copy(first20names.begin(), first20names.end(), ostream_iterator<string>(cout, "\n"));
+    copy(first20names.begin(), first20names.end(), ostream_iterator<string_view>(cout, "\n"));
     cout << "-----------------------------------------------------------\n\n";
 
     // ----------------------------
@@ -0,0 +1,205 @@
+// gen_students.cpp
+// Synthetic dataset generator for the ERP programs.
+// Emits CSVs in the students_3000.csv schema:
+//   name,roll,branch,start_year,current_courses,previous_courses_with_grades
+// at any size (10K .. 50M rows), reproducibly from a seed, so loading, sorting
+// and indexing can be benchmarked at production scale.
+//
+// Compile:
+//   g++ -std=c++17 gen_students.cpp -O2 -o gen_students   (or: make gen_students)
+// Run:
+//   ./gen_students --rows 1000000 --seed 7 --out students_big.csv
+//   make dataset ROWS=5000000          (writes students_gen.csv)
+//
+// Knobs (defaults reproduce the shape of students_3000.csv):
+//   --rows N               number of data rows                      (3000)
+//   --seed S               RNG seed; same seed + knobs = same file  (42)
+//   --out FILE             output path, '-' for stdout              (-)
+//   --numeric-rolls P      % of rolls that are plain integers        (70)
+//   --numeric-courses P    % of course codes drawn as IIT numbers    (50)
+//   --current MIN:MAX      current courses per student               (4:6)
+//   --previous MIN:MAX     previous (graded) courses per student     (5:9)
+//   --grades uniform|normal                                          (uniform)
+//   --grade-range LO:HI    uniform range / clamp for normal, 0..10   (5.0:10.0)
+//   --grade-mean M --grade-stddev SD   parameters for 'normal'       (7.5, 1.2)
+//   --branch-skew Z        Zipf exponent over branches, 0 = uniform  (0)
+//   --malformed P          % of rows damaged (short row, junk grade,
+//                          junk year or a course without '|')        (0)
+
+#include <bits/stdc++.h>
+using namespace std;
+
+struct GenConfig {
+    uint64_t rows = 3000;
+    uint64_t seed = 42;
+    string out = "-";
+    double numeric_roll_pct = 70.0;
+    double numeric_course_pct = 50.0;
+    int cur_min = 4, cur_max = 6;
+    int prev_min = 5, prev_max = 9;
+    bool normal_grades = false;
+    double grade_lo = 5.0, grade_hi = 10.0;
+    double grade_mean = 7.5, grade_stddev = 1.2;
+    double branch_skew = 0.0;
+    double malformed_pct = 0.0;
+};
+
+static const vector<string> FIRST_NAMES = {
+    "Aarav","Vihaan","Arjun","Ananya","Tanvi","Ishaan","Diya","Kabir","Meera","Rohan",
+    "Saanvi","Aditya","Kavya","Reyansh","Myra","Vivaan","Anika","Krishna","Riya","Dhruv"
+};
+static const vector<string> LAST_NAMES = {
+    "Verma","Chowdhury","Kumar","Patel","Sharma","Gupta","Singh","Iyer","Reddy","Nair",
+    "Mehta","Joshi","Das","Bose","Kapoor","Malhotra","Rao","Pillai","Saxena","Mishra"
+};
+static const vector<string> BRANCHES = { "CSE","ECE","EE","ME","CE","BT","Maths","Physics" };
+static const vector<string> IIIT_COURSES = { "OOPS","DSA","DBMS","OS","CN","NLP","ML","AI","SE","CNTR" };
+static const vector<string> IIT_COURSES = { "101","102","201","202","301","302","401","402","501","502" };
+
+static bool parse_range_arg(const string &v, int &lo, int &hi) {
+    auto c = v.find(':');
+    if (c == string::npos) return false;
+    try { lo = stoi(v.substr(0, c)); hi = stoi(v.substr(c + 1)); } catch(...) { return false; }
+    return lo >= 0 && hi >= lo;
+}
+
+static bool parse_args(int argc, char** argv, GenConfig &cfg) {
+    for (int i = 1; i < argc; ++i) {
+        string a = argv[i];
+        auto next = [&]() -> string { return (i + 1 < argc) ? string(argv[++i]) : string(); };
+        try {
+            if (a == "--rows") cfg.rows = stoull(next());
+            else if (a == "--seed") cfg.seed = stoull(next());
+            else if (a == "--out") cfg.out = next();
+            else if (a == "--numeric-rolls") cfg.numeric_roll_pct = stod(next());
+            else if (a == "--numeric-courses") cfg.numeric_course_pct = stod(next());
+            else if (a == "--current") { if (!parse_range_arg(next(), cfg.cur_min, cfg.cur_max)) return false; }
+            else if (a == "--previous") { if (!parse_range_arg(next(), cfg.prev_min, cfg.prev_max)) return false; }
+            else if (a == "--grades") {
+                string g = next();
+                if (g == "normal") cfg.normal_grades = true;
+                else if (g == "uniform") cfg.normal_grades = false;
+                else return false;
+            }
+            else if (a == "--grade-range") {
+                string v = next(); auto c = v.find(':');
+                if (c == string::npos) return false;
+                cfg.grade_lo = stod(v.substr(0, c)); cfg.grade_hi = stod(v.substr(c + 1));
+                // the loaders reject grades outside 0..10 (FastCSV::MAX_GRADE)
+                if (!(cfg.grade_lo >= 0 && cfg.grade_hi <= 10.0 && cfg.grade_lo <= cfg.grade_hi)) {
+                    cerr << "--grade-range must satisfy 0 <= LO <= HI <= 10\n";
+                    return false;
+                }
+            }
+            else if (a == "--grade-mean") cfg.grade_mean = stod(next());
+            else if (a == "--grade-stddev") cfg.grade_stddev = stod(next());
+            else if (a == "--branch-skew") cfg.branch_skew = stod(next());
+            else if (a == "--malformed") cfg.malformed_pct = stod(next());
+            else { cerr << "Unknown option '" << a << "'\n"; return false; }
+        } catch(...) {
+            cerr << "Bad value for " << a << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    ios::sync_with_stdio(false);
+
+    GenConfig cfg;
+    if (!parse_args(argc, argv, cfg)) {
+        cerr << "Usage: gen_students [--rows N] [--seed S] [--out FILE] [--numeric-rolls P] [--numeric-courses P]\n"
+             << "                    [--current MIN:MAX] [--previous MIN:MAX] [--grades uniform|normal]\n"
+             << "                    [--grade-range LO:HI] [--grade-mean M] [--grade-stddev SD]\n"
+             << "                    [--branch-skew Z] [--malformed P]\n";
+        return 2;
+    }
+
+    FILE *fout = stdout;
+    if (cfg.out != "-") {
+        fout = fopen(cfg.out.c_str(), "wb");
+        if (!fout) { cerr << "ERROR: cannot write " << cfg.out << "\n"; return 1; }
+    }
+
+    mt19937_64 rng(cfg.seed);
+    uniform_real_distribution<double> pct(0.0, 100.0);
+    uniform_int_distribution<size_t> first_pick(0, FIRST_NAMES.size() - 1), last_pick(0, LAST_NAMES.size() - 1);
+    uniform_int_distribution<size_t> course_pick(0, IIIT_COURSES.size() - 1);
+    uniform_int_distribution<int> year_pick(2019, 2023);
+    uniform_int_distribution<int> cur_count(cfg.cur_min, cfg.cur_max), prev_count(cfg.prev_min, cfg.prev_max);
+    uniform_int_distribution<int> malformed_kind(0, 3);
+    // grades are emitted with one decimal, like the registrar export
+    int tenth_lo = (int)llround(cfg.grade_lo * 10), tenth_hi = (int)llround(cfg.grade_hi * 10);
+    uniform_int_distribution<int> uniform_tenths(tenth_lo, tenth_hi);
+    normal_distribution<double> normal_grade(cfg.grade_mean, cfg.grade_stddev);
+
+    // Zipf weights over branches (exponent 0 = uniform)
+    vector<double> weights;
+    for (size_t b = 0; b < BRANCHES.size(); ++b) weights.push_back(1.0 / pow((double)(b + 1), cfg.branch_skew));
+    discrete_distribution<size_t> branch_pick(weights.begin(), weights.end());
+
+    auto course = [&]() -> const string& {
+        size_t c = course_pick(rng);
+        return pct(rng) < cfg.numeric_course_pct ? IIT_COURSES[c] : IIIT_COURSES[c];
+    };
+    auto grade_tenths = [&]() {
+        if (!cfg.normal_grades) return uniform_tenths(rng);
+        double g = min(cfg.grade_hi, max(cfg.grade_lo, normal_grade(rng)));
+        return (int)llround(g * 10);
+    };
+
+    string buf;
+    buf.reserve(1 << 22);
+    buf += "name,roll,branch,start_year,current_courses,previous_courses_with_grades\n";
+    char num[32];
+    uint64_t damaged = 0; // rows a defect was actually written to
+    for (uint64_t row = 1; row <= cfg.rows; ++row) {
+        int kind = -1;
+        if (cfg.malformed_pct > 0 && pct(rng) < cfg.malformed_pct) kind = malformed_kind(rng);
+        const string &branch = BRANCHES[branch_pick(rng)];
+        int year = year_pick(rng);
+
+        buf += FIRST_NAMES[first_pick(rng)]; buf += ' '; buf += LAST_NAMES[last_pick(rng)]; buf += ',';
+        if (pct(rng) < cfg.numeric_roll_pct) {
+            snprintf(num, sizeof num, "%llu", (unsigned long long)(200000 + row));
+        } else {
+            snprintf(num, sizeof num, "%s%d-%03llu", branch.c_str(), year, (unsigned long long)row);
+        }
+        buf += num; buf += ','; buf += branch; buf += ',';
+        if (kind == 2) { buf += "20x1"; ++damaged; } // junk start_year
+        else { snprintf(num, sizeof num, "%d", year); buf += num; }
+        buf += ',';
+        int nc = cur_count(rng);
+        for (int k = 0; k < nc; ++k) { if (k) buf += ';'; buf += course(); }
+        if (kind == 0) { // short row: previous courses column missing
+            buf += '\n';
+            ++damaged;
+        } else {
+            buf += ',';
+            int np = prev_count(rng);
+            // a row without previous courses has no grade to damage and stays valid
+            int bad_at = (kind == 1 || kind == 3) && np > 0 ? (int)(rng() % (uint64_t)np) : -1;
+            if (bad_at >= 0) ++damaged;
+            for (int k = 0; k < np; ++k) {
+                if (k) buf += ';';
+                buf += course();
+                if (k == bad_at && kind == 3) continue; // course without '|grade'
+                buf += '|';
+                if (k == bad_at && kind == 1) { buf += "x.y"; continue; } // junk grade
+                int t = grade_tenths();
+                snprintf(num, sizeof num, "%d.%d", t / 10, t % 10);
+                buf += num;
+            }
+            buf += '\n';
+        }
+        if (buf.size() >= (1 << 22) - 512) { fwrite(buf.data(), 1, buf.size(), fout); buf.clear(); }
+    }
+    fwrite(buf.data(), 1, buf.size(), fout);
+    if (fout != stdout) fclose(fout);
+
+    cerr << "Generated " << cfg.rows << " rows (" << damaged << " malformed) with seed " << cfg.seed;
+    if (cfg.out != "-") cerr << " -> " << cfg.out;
+    cerr << "\n";
+    return 0;
+}
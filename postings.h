@@ -0,0 +1,357 @@
+// postings.h
+// Grade postings of one course: every graded attempt as {grade, student},
+// highest grade first and ascending student id among equal grades, so
+// "grade >= x" is a prefix and "grade in [a, b]" a contiguous slice.
+//
+// A List is a counted B+ tree. Leaves hold up to LEAF_MAX postings as two
+// columns (grade, student: 12 bytes a posting); inner nodes hold up to FANOUT
+// children with the posting count and the last posting of each. Ranks, grade
+// ranges and a single insert or erase walk one root-to-leaf path, so they cost
+// O(log n) plus a shift inside one leaf and one node per level (bounded by
+// LEAF_MAX / FANOUT), never a shift of the whole list.
+//
+// Nodes are shared: copying a List copies its root pointer, and a change
+// copies the nodes on its path that another copy still uses (Cow::own), so a
+// copy never sees changes made to another one. Erases do not merge small
+// neighbours; a node is only dropped once it is empty. build() can take its
+// nodes from a memory resource (a load's Cow::Arena); the nodes a change
+// creates or copies come from the heap. wrap() builds a list whose leaves
+// point at postings that live elsewhere (a mapped snapshot), like
+// Cow::Column::wrap: only the inner nodes are built, and the first change to
+// a leaf copies just that leaf.
+
+#ifndef POSTINGS_H
+#define POSTINGS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+#include "cow.h"
+
+namespace Postings {
+
+// list order: higher grade first, then lower student id
+inline bool before(double ga, uint32_t sa, double gb, uint32_t sb) {
+    return ga > gb || (ga == gb && sa < sb);
+}
+
+class List {
+public:
+    static const size_t LEAF_MAX = 256;
+    static const size_t FANOUT = 64;
+
+    size_t size() const { return root_ ? root_->count : 0; }
+    bool empty() const { return size() == 0; }
+
+    // Position of posting {g, s}: the number of postings ordered before it.
+    size_t rank(double g, uint32_t s) const {
+        return count_while([g, s](double pg, uint32_t ps) { return before(pg, ps, g, s); });
+    }
+    // Positions [first, last) of the postings with lo <= grade <= hi.
+    std::pair<size_t, size_t> range(double lo, double hi) const {
+        size_t first = count_while([hi](double pg, uint32_t) { return pg > hi; });
+        size_t last = count_while([lo](double pg, uint32_t) { return pg >= lo; });
+        return { first, std::max(first, last) };
+    }
+    // posting at position k < size()
+    std::pair<double, uint32_t> at(size_t k) const {
+        const Node *x = root_.get();
+        while (!x->leaf) {
+            size_t i = 0;
+            while (k >= x->child_count[i]) k -= x->child_count[i++];
+            x = x->child[i].get();
+        }
+        return { x->gp[k], x->sp[k] };
+    }
+    bool contains(double g, uint32_t s) const {
+        size_t k = rank(g, s);
+        return k < size() && at(k) == std::make_pair(g, s);
+    }
+
+    // f(grade, student) for the postings at positions [first, last), in order.
+    template<typename F>
+    void for_each(size_t first, size_t last, F &&f) const {
+        last = std::min(last, size());
+        if (first < last) visit(*root_, first, last, f);
+    }
+    template<typename F>
+    void for_each(F &&f) const { for_each(0, size(), f); }
+
+    // Add one posting at rank(g, s). Equal postings are kept side by side (a
+    // student can repeat a course with the same grade), as build() keeps them.
+    void insert(double g, uint32_t s) {
+        if (!root_) root_ = std::make_shared<Node>();
+        std::shared_ptr<Node> right = insert_at(root_, g, s);
+        if (right) {
+            auto top = std::make_shared<Node>();
+            top->leaf = false;
+            adopt(*top, std::move(root_));
+            adopt(*top, std::move(right));
+            root_ = std::move(top);
+        }
+    }
+    // Remove one copy of posting {g, s}; false when there is none.
+    bool erase(double g, uint32_t s) {
+        if (!contains(g, s)) return false;
+        erase_at(root_, g, s);
+        if (root_->count == 0) root_.reset();
+        while (root_ && !root_->leaf && root_->child.size() == 1) {
+            std::shared_ptr<Node> only = root_->child[0];
+            root_ = std::move(only);
+        }
+        return true;
+    }
+
+    // The list of n postings that are already in list order (copied), with
+    // its nodes allocated from 'mr' (null: the heap), which must outlive the
+    // list and every copy of it.
+    static List build(const double *grade, const uint32_t *student, size_t n, std::pmr::memory_resource *mr = nullptr) {
+        std::vector<std::shared_ptr<Node>> level;
+        for (size_t b = 0; b < n; b += LEAF_MAX) {
+            size_t e = std::min(n, b + LEAF_MAX);
+            auto leaf = make_node(mr);
+            leaf->grade.assign(grade + b, grade + e);
+            leaf->student.assign(student + b, student + e);
+            leaf->count = e - b;
+            leaf->sync();
+            level.push_back(std::move(leaf));
+        }
+        List l;
+        l.root_ = stack(std::move(level), mr);
+        return l;
+    }
+    // The list of the n postings at grade / student, in list order, which
+    // must stay valid and unchanged while this list or a copy of it can read
+    // them. Its leaves point there; the inner nodes come from 'mr' (null: the
+    // heap), as in build().
+    static List wrap(const double *grade, const uint32_t *student, size_t n, std::pmr::memory_resource *mr = nullptr) {
+        std::vector<std::shared_ptr<Node>> level;
+        for (size_t b = 0; b < n; b += LEAF_MAX) {
+            auto leaf = make_node(mr);
+            leaf->gp = grade + b;
+            leaf->sp = student + b;
+            leaf->count = std::min(n, b + LEAF_MAX) - b;
+            level.push_back(std::move(leaf));
+        }
+        List l;
+        l.root_ = stack(std::move(level), mr);
+        return l;
+    }
+
+private:
+    // A leaf reads its postings at gp / sp: in 'grade' and 'student', or in
+    // wrapped memory (both empty) until materialize() copies them in. A copy
+    // (Cow::own) always owns its postings and allocates its vectors from the
+    // heap, whatever resource the original uses.
+    struct Node {
+        size_t count = 0;  // postings in this subtree
+        bool leaf = true;
+        // leaf: the postings, in order
+        const double *gp = nullptr;
+        const uint32_t *sp = nullptr;
+        std::pmr::vector<double> grade;
+        std::pmr::vector<uint32_t> student;
+        // inner: the children, in order, with their counts and last postings
+        std::pmr::vector<std::shared_ptr<Node>> child;
+        std::pmr::vector<size_t> child_count;
+        std::pmr::vector<double> last_grade;
+        std::pmr::vector<uint32_t> last_student;
+
+        explicit Node(std::pmr::memory_resource *mr = std::pmr::get_default_resource())
+            : grade(mr), student(mr), child(mr), child_count(mr), last_grade(mr), last_student(mr) {}
+        Node(const Node &o)
+            : count(o.count), leaf(o.leaf),
+              grade(o.gp, o.gp + (o.leaf ? o.count : 0)), student(o.sp, o.sp + (o.leaf ? o.count : 0)),
+              child(o.child), child_count(o.child_count), last_grade(o.last_grade), last_student(o.last_student) { sync(); }
+        Node& operator=(const Node&) = delete;
+
+        // point gp / sp at the vectors again after they changed
+        void sync() { gp = grade.data(); sp = student.data(); }
+        // a leaf about to change: its postings copied out of wrapped memory
+        void materialize() {
+            if (gp == grade.data()) return;
+            grade.assign(gp, gp + count);
+            student.assign(sp, sp + count);
+            sync();
+        }
+    };
+    static std::shared_ptr<Node> make_node(std::pmr::memory_resource *mr) {
+        if (!mr) return std::make_shared<Node>();
+        return std::allocate_shared<Node>(std::pmr::polymorphic_allocator<Node>(mr), mr);
+    }
+
+    // Number of postings p with pred(p), for a pred that holds on a prefix.
+    template<typename P>
+    size_t count_while(P pred) const {
+        size_t n = 0;
+        for (const Node *x = root_.get(); x; ) {
+            if (x->leaf) {
+                size_t lo = 0, hi = x->count;
+                while (lo < hi) {
+                    size_t mid = lo + (hi - lo) / 2;
+                    if (pred(x->gp[mid], x->sp[mid])) lo = mid + 1;
+                    else hi = mid;
+                }
+                return n + lo;
+            }
+            size_t i = 0;
+            while (i + 1 < x->child.size() && pred(x->last_grade[i], x->last_student[i])) n += x->child_count[i++];
+            x = x->child[i].get();
+        }
+        return n;
+    }
+
+    template<typename F>
+    static void visit(const Node &x, size_t first, size_t last, F &f) {
+        if (x.leaf) {
+            for (size_t k = first; k < last; ++k) f(x.gp[k], x.sp[k]);
+            return;
+        }
+        size_t base = 0;
+        for (size_t i = 0; i < x.child.size() && base < last; ++i) {
+            size_t c = x.child_count[i];
+            if (base + c > first) visit(*x.child[i], first > base ? first - base : 0, std::min(last - base, c), f);
+            base += c;
+        }
+    }
+
+    static std::pair<double, uint32_t> last_of(const Node &x) {
+        if (x.leaf) return { x.gp[x.count - 1], x.sp[x.count - 1] };
+        return { x.last_grade.back(), x.last_student.back() };
+    }
+    // child i of inner node x, where posting {g, s} is or belongs
+    static size_t child_for(const Node &x, double g, uint32_t s) {
+        size_t i = 0;
+        while (i + 1 < x.child.size() && before(x.last_grade[i], x.last_student[i], g, s)) ++i;
+        return i;
+    }
+    static size_t leaf_rank(const Node &x, double g, uint32_t s) {
+        size_t lo = 0, hi = x.count;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (before(x.gp[mid], x.sp[mid], g, s)) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    // append child c to inner node x
+    static void adopt(Node &x, std::shared_ptr<Node> c) {
+        auto last = last_of(*c);
+        x.count += c->count;
+        x.child_count.push_back(c->count);
+        x.last_grade.push_back(last.first);
+        x.last_student.push_back(last.second);
+        x.child.push_back(std::move(c));
+    }
+    // re-read the count and last posting of child i of x after it changed
+    static void refresh(Node &x, size_t i) {
+        auto last = last_of(*x.child[i]);
+        x.child_count[i] = x.child[i]->count;
+        x.last_grade[i] = last.first;
+        x.last_student[i] = last.second;
+    }
+
+    // Move the upper half of x into a new node and return it.
+    static std::shared_ptr<Node> split(Node &x) {
+        auto right = std::make_shared<Node>();
+        right->leaf = x.leaf;
+        if (x.leaf) {
+            size_t h = x.count / 2;
+            right->grade.assign(x.grade.begin() + (std::ptrdiff_t)h, x.grade.end());
+            right->student.assign(x.student.begin() + (std::ptrdiff_t)h, x.student.end());
+            right->count = x.count - h;
+            right->sync();
+            x.grade.resize(h);
+            x.student.resize(h);
+            x.count = h;
+            x.sync();
+            return right;
+        }
+        size_t h = x.child.size() / 2;
+        for (size_t i = h; i < x.child.size(); ++i) adopt(*right, std::move(x.child[i]));
+        x.child.resize(h);
+        x.child_count.resize(h);
+        x.last_grade.resize(h);
+        x.last_student.resize(h);
+        x.count -= right->count;
+        return right;
+    }
+
+    // Insert below 'slot' (copied first if shared); returns the new right
+    // sibling when the node had to be split.
+    static std::shared_ptr<Node> insert_at(std::shared_ptr<Node> &slot, double g, uint32_t s) {
+        Node &x = Cow::own(slot);
+        if (x.leaf) {
+            x.materialize();
+            std::ptrdiff_t k = (std::ptrdiff_t)leaf_rank(x, g, s);
+            x.grade.insert(x.grade.begin() + k, g);
+            x.student.insert(x.student.begin() + k, s);
+            ++x.count;
+            x.sync();
+            return x.count > LEAF_MAX ? split(x) : nullptr;
+        }
+        ++x.count;
+        size_t i = child_for(x, g, s);
+        std::shared_ptr<Node> right = insert_at(x.child[i], g, s);
+        refresh(x, i);
+        if (right) {
+            auto last = last_of(*right);
+            std::ptrdiff_t at = (std::ptrdiff_t)i + 1;
+            x.child_count.insert(x.child_count.begin() + at, right->count);
+            x.last_grade.insert(x.last_grade.begin() + at, last.first);
+            x.last_student.insert(x.last_student.begin() + at, last.second);
+            x.child.insert(x.child.begin() + at, std::move(right));
+        }
+        return x.child.size() > FANOUT ? split(x) : nullptr;
+    }
+
+    // Erase a posting that is there; children left empty are dropped.
+    static void erase_at(std::shared_ptr<Node> &slot, double g, uint32_t s) {
+        Node &x = Cow::own(slot);
+        if (x.leaf) {
+            x.materialize();
+            std::ptrdiff_t k = (std::ptrdiff_t)leaf_rank(x, g, s);
+            x.grade.erase(x.grade.begin() + k);
+            x.student.erase(x.student.begin() + k);
+            --x.count;
+            x.sync();
+            return;
+        }
+        --x.count;
+        size_t i = child_for(x, g, s);
+        erase_at(x.child[i], g, s);
+        if (x.child[i]->count) { refresh(x, i); return; }
+        std::ptrdiff_t at = (std::ptrdiff_t)i;
+        x.child.erase(x.child.begin() + at);
+        x.child_count.erase(x.child_count.begin() + at);
+        x.last_grade.erase(x.last_grade.begin() + at);
+        x.last_student.erase(x.last_student.begin() + at);
+    }
+
+    // inner levels over a row of nodes; returns the root
+    static std::shared_ptr<Node> stack(std::vector<std::shared_ptr<Node>> level, std::pmr::memory_resource *mr) {
+        if (level.empty()) return nullptr;
+        while (level.size() > 1) {
+            std::vector<std::shared_ptr<Node>> up;
+            for (size_t b = 0; b < level.size(); b += FANOUT) {
+                auto x = make_node(mr);
+                x->leaf = false;
+                for (size_t i = b; i < std::min(level.size(), b + FANOUT); ++i) adopt(*x, std::move(level[i]));
+                up.push_back(std::move(x));
+            }
+            level.swap(up);
+        }
+        return level[0];
+    }
+
+    std::shared_ptr<Node> root_;
+};
+
+} // namespace Postings
+
+#endif // POSTINGS_H
@@ -0,0 +1,260 @@
+// roaring.h
+// Compressed bitmap of 32-bit ids (student rows) in the style of Roaring bitmaps.
+// An id is split into a 16-bit key (high half) and a 16-bit value (low half).
+// Each key present gets one container for its 65536 values, kept in one of two
+// forms:
+//   - sparse: sorted array of uint16 values while it holds <= ARRAY_MAX of them
+//   - dense:  65536-bit bitset (1024 words) once it holds more
+// So a bitmap costs ~2 bytes per id when sparse and at most 8 KB per 65536 ids
+// when dense. AND / OR / AND-NOT run container by container: array-array as
+// sorted merges, anything involving a bitset one 64-bit word at a time, and
+// cardinalities come from the stored counts (popcount for dense results).
+//
+// Ids are added (and removed) in any order, but adding in ascending order (how
+// the ERP index builds them) always hits the append fast path.
+//
+// Containers are shared between copies of a bitmap (and with the results of
+// OR / AND-NOT that pass them through unchanged): copying a bitmap costs one
+// pointer per container, and add / remove copy the one container they change
+// when another bitmap still uses it (cow.h).
+//
+// for_each_container() / append_container() hand the containers out and take
+// them back as flat arrays, so a bitmap can be written to a file and read back
+// with one copy per container instead of being rebuilt id by id.
+
+#ifndef ROARING_H
+#define ROARING_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <vector>
+#include "cow.h"
+
+namespace Roaring {
+
+class Bitmap {
+public:
+    static const uint32_t ARRAY_MAX = 4096; // above this a container becomes a bitset
+    static const size_t WORDS = 65536 / 64;
+
+    void add(uint32_t x) {
+        Container &c = Cow::own(container_for((uint16_t)(x >> 16)));
+        uint16_t v = (uint16_t)x;
+        if (c.dense()) {
+            uint64_t &w = c.bits[v >> 6], bit = uint64_t(1) << (v & 63);
+            if (!(w & bit)) { w |= bit; ++c.card; }
+            return;
+        }
+        if (c.array.empty() || c.array.back() < v) c.array.push_back(v);
+        else {
+            auto it = std::lower_bound(c.array.begin(), c.array.end(), v);
+            if (*it == v) return;
+            c.array.insert(it, v);
+        }
+        if (++c.card > ARRAY_MAX) to_dense(c);
+    }
+
+    void remove(uint32_t x) {
+        auto k = std::lower_bound(keys_.begin(), keys_.end(), (uint16_t)(x >> 16));
+        if (k == keys_.end() || *k != (uint16_t)(x >> 16)) return;
+        size_t i = (size_t)(k - keys_.begin());
+        if (!cont_[i]->test((uint16_t)x)) return;
+        Container &c = Cow::own(cont_[i]);
+        uint16_t v = (uint16_t)x;
+        if (c.dense()) {
+            c.bits[v >> 6] &= ~(uint64_t(1) << (v & 63));
+            if (--c.card <= ARRAY_MAX) to_sparse(c);
+        } else {
+            c.array.erase(std::lower_bound(c.array.begin(), c.array.end(), v));
+            --c.card;
+        }
+        if (c.card == 0) {
+            keys_.erase(k);
+            cont_.erase(cont_.begin() + (std::ptrdiff_t)i);
+        }
+    }
+
+    bool contains(uint32_t x) const {
+        auto k = std::lower_bound(keys_.begin(), keys_.end(), (uint16_t)(x >> 16));
+        if (k == keys_.end() || *k != (uint16_t)(x >> 16)) return false;
+        return cont_[(size_t)(k - keys_.begin())]->test((uint16_t)x);
+    }
+
+    uint64_t cardinality() const {
+        uint64_t n = 0;
+        for (const auto &c : cont_) n += c->card;
+        return n;
+    }
+    bool empty() const { return cont_.empty(); }
+    // largest id of a bitmap that is not empty
+    uint32_t last() const {
+        const Container &c = *cont_.back();
+        uint32_t high = (uint32_t)keys_.back() << 16;
+        if (!c.dense()) return high | c.array.back();
+        size_t w = WORDS;
+        while (!c.bits[--w]) {}
+        return high | (uint32_t)(w * 64 + 63 - (size_t)__builtin_clzll(c.bits[w]));
+    }
+
+    // f(id) for every id, ascending
+    template<typename F>
+    void for_each(F &&f) const {
+        for (size_t i = 0; i < keys_.size(); ++i) {
+            uint32_t high = (uint32_t)keys_[i] << 16;
+            const Container &c = *cont_[i];
+            if (!c.dense()) { for (uint16_t v : c.array) f(high | v); continue; }
+            for (size_t w = 0; w < WORDS; ++w)
+                for (uint64_t bits = c.bits[w]; bits; bits &= bits - 1)
+                    f(high | (uint32_t)(w * 64 + (size_t)__builtin_ctzll(bits)));
+        }
+    }
+
+    // f(key, card, values, bits) for every container, ascending key: a sparse
+    // one passes its card sorted values (bits null), a dense one its WORDS
+    // words (values null).
+    template<typename F>
+    void for_each_container(F &&f) const {
+        for (size_t i = 0; i < keys_.size(); ++i) {
+            const Container &c = *cont_[i];
+            f(keys_[i], c.card, c.dense() ? nullptr : c.array.data(), c.dense() ? c.bits.data() : nullptr);
+        }
+    }
+    // Append a container in the form for_each_container() gives, with a key
+    // above every key present. False (nothing appended) when the data is not
+    // such a container: values unsorted, card wrong, the wrong form for card.
+    bool append_container(uint16_t key, uint32_t card, const uint16_t *values, const uint64_t *bits) {
+        if ((!keys_.empty() && keys_.back() >= key) || card == 0 || (bits != nullptr) != (card > ARRAY_MAX)) return false;
+        auto c = std::make_shared<Container>();
+        if (bits) {
+            uint64_t n = 0;
+            for (size_t w = 0; w < WORDS; ++w) n += (uint64_t)__builtin_popcountll(bits[w]);
+            if (n != card) return false;
+            c->bits.assign(bits, bits + WORDS);
+        } else {
+            for (uint32_t k = 1; k < card; ++k) if (values[k-1] >= values[k]) return false;
+            c->array.assign(values, values + card);
+        }
+        c->card = card;
+        keys_.push_back(key);
+        cont_.push_back(std::move(c));
+        return true;
+    }
+
+    friend Bitmap operator&(const Bitmap &a, const Bitmap &b) { return combine(a, b, Op::And); }
+    friend Bitmap operator|(const Bitmap &a, const Bitmap &b) { return combine(a, b, Op::Or); }
+    friend Bitmap and_not(const Bitmap &a, const Bitmap &b) { return combine(a, b, Op::AndNot); }
+    Bitmap& operator&=(const Bitmap &o) { return *this = *this & o; }
+    Bitmap& operator|=(const Bitmap &o) { return *this = *this | o; }
+
+private:
+    struct Container {
+        std::vector<uint16_t> array; // sorted values (sparse form)
+        std::vector<uint64_t> bits;  // WORDS words (dense form), empty while sparse
+        uint32_t card = 0;
+        bool dense() const { return !bits.empty(); }
+        bool test(uint16_t v) const {
+            if (dense()) return (bits[v >> 6] >> (v & 63)) & 1;
+            return std::binary_search(array.begin(), array.end(), v);
+        }
+    };
+    enum class Op { And, Or, AndNot };
+
+    static void to_dense(Container &c) {
+        c.bits.assign(WORDS, 0);
+        for (uint16_t v : c.array) c.bits[v >> 6] |= uint64_t(1) << (v & 63);
+        c.array.clear();
+        c.array.shrink_to_fit();
+    }
+    static void to_sparse(Container &c) {
+        c.array.clear();
+        c.array.reserve(c.card);
+        for (size_t w = 0; w < WORDS; ++w)
+            for (uint64_t bits = c.bits[w]; bits; bits &= bits - 1)
+                c.array.push_back((uint16_t)(w * 64 + (size_t)__builtin_ctzll(bits)));
+        c.bits.clear();
+        c.bits.shrink_to_fit();
+    }
+
+    // the slot of key's container, with an empty container when it is new
+    std::shared_ptr<Container>& container_for(uint16_t key) {
+        if (keys_.empty() || keys_.back() < key) {
+            keys_.push_back(key);
+            cont_.push_back(std::make_shared<Container>());
+            return cont_.back();
+        }
+        auto k = std::lower_bound(keys_.begin(), keys_.end(), key);
+        size_t i = (size_t)(k - keys_.begin());
+        if (*k != key) { keys_.insert(k, key); cont_.insert(cont_.begin() + (std::ptrdiff_t)i, std::make_shared<Container>()); }
+        return cont_[i];
+    }
+
+    static Container combine(const Container &a, const Container &b, Op op) {
+        Container r;
+        if (!a.dense() && !b.dense()) {
+            auto out = std::back_inserter(r.array);
+            if (op == Op::And) std::set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), out);
+            else if (op == Op::Or) std::set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), out);
+            else std::set_difference(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), out);
+            r.card = (uint32_t)r.array.size();
+            if (r.card > ARRAY_MAX) to_dense(r);
+            return r;
+        }
+        // a sparse side filtered through a dense one stays sparse
+        if ((op == Op::And && (!a.dense() || !b.dense())) || (op == Op::AndNot && !a.dense())) {
+            const Container &s = a.dense() ? b : a, &d = a.dense() ? a : b;
+            bool keep = op == Op::And;
+            for (uint16_t v : s.array) if (d.test(v) == keep) r.array.push_back(v);
+            r.card = (uint32_t)r.array.size();
+            return r;
+        }
+        // word at a time; the sparse side (if any) is expanded first
+        Container wa = a, wb = b;
+        if (!wa.dense()) to_dense(wa);
+        if (!wb.dense()) to_dense(wb);
+        r.bits.resize(WORDS);
+        uint64_t card = 0;
+        for (size_t w = 0; w < WORDS; ++w) {
+            uint64_t x = op == Op::And ? (wa.bits[w] & wb.bits[w])
+                       : op == Op::Or ? (wa.bits[w] | wb.bits[w]) : (wa.bits[w] & ~wb.bits[w]);
+            r.bits[w] = x;
+            card += (uint64_t)__builtin_popcountll(x);
+        }
+        r.card = (uint32_t)card;
+        if (r.card <= ARRAY_MAX) to_sparse(r);
+        return r;
+    }
+
+    static Bitmap combine(const Bitmap &a, const Bitmap &b, Op op) {
+        Bitmap r;
+        size_t i = 0, j = 0;
+        auto put = [&r](uint16_t key, std::shared_ptr<Container> c) {
+            if (c->card == 0) return;
+            r.keys_.push_back(key);
+            r.cont_.push_back(std::move(c));
+        };
+        while (i < a.keys_.size() || j < b.keys_.size()) {
+            bool has_a = i < a.keys_.size(), has_b = j < b.keys_.size();
+            if (has_a && has_b && a.keys_[i] == b.keys_[j]) {
+                put(a.keys_[i], std::make_shared<Container>(combine(*a.cont_[i], *b.cont_[j], op)));
+                ++i; ++j;
+            } else if (has_a && (!has_b || a.keys_[i] < b.keys_[j])) {
+                if (op != Op::And) put(a.keys_[i], a.cont_[i]);
+                ++i;
+            } else {
+                if (op == Op::Or) put(b.keys_[j], b.cont_[j]);
+                ++j;
+            }
+        }
+        return r;
+    }
+
+    std::vector<uint16_t> keys_;    // ascending high halves
+    std::vector<std::shared_ptr<Container>> cont_; // cont_[i] holds the ids with high half keys_[i]
+};
+
+} // namespace Roaring
+
+#endif // ROARING_H
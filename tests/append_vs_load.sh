@@ -0,0 +1,45 @@
+#!/bin/bash
+# tests/append_vs_load.sh ERP_MENU
+# A row appended and ingested with option 6 must index exactly like the same
+# row loaded with the file: here a repeated attempt with the same grade
+# (ML|9.5 twice), compared through the Q5 export, before and after one of the
+# two attempts is dropped with option 11.
+set -e
+MENU=$(realpath "${1:-./erp_menu}")
+SRC=$(realpath "$(dirname "$0")/../students_3000.csv")
+ROW='"Dup Attempt","9999",CSE,2020,ML,ML|9.5;ML|9.5'
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK"
+
+# export_after APPEND EDIT OUT: Q5 export (grade >= 9.5) after an optional
+# append (ingested with option 6) and an optional registrar edit
+export_after() {
+    cp "$SRC" s.csv
+    [ "$1" = load ] && echo "$ROW" >> s.csv
+    rm -f in.fifo out.txt high_grade_students.csv
+    mkfifo in.fifo
+    "$MENU" --csv s.csv < in.fifo > out.txt 2>&1 &
+    exec 3> in.fifo
+    until grep -q "Enter choice" out.txt; do sleep 0.1; done
+    if [ "$1" = append ]; then echo "$ROW" >> s.csv; printf '6\n\n' >&3; fi
+    [ -n "$2" ] && printf '11\n%s\n\n' "$2" >&3
+    printf '5\n2 9.5\n\n0\n' >&3
+    exec 3>&-
+    wait
+    grep -q "Appended 1 new students" out.txt || [ "$1" != append ]
+    mv high_grade_students.csv "$3"
+}
+
+status=0
+for edit in "" "drop 9999 ML"; do
+    export_after load "$edit" loaded.csv
+    export_after append "$edit" appended.csv
+    if ! cmp -s loaded.csv appended.csv; then
+        echo "FAIL: append differs from load${edit:+ after '$edit'}"
+        diff loaded.csv appended.csv | head
+        status=1
+    fi
+done
+[ $status = 0 ] && echo "append_vs_load: ok"
+exit $status
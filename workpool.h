@@ -0,0 +1,253 @@
+// workpool.h
+// Long-lived work-stealing thread pool for the threaded builds (USE_STD_THREAD or
+// USE_POSIX). The programs keep their ThreadWrapper start()/join() interface, but
+// start() now forks a task into this pool instead of creating an OS thread, and
+// join() waits for that task. Repeated menu operations therefore reuse the same
+// worker threads, and a burst of start() calls never runs more threads than CPUs.
+//
+// Every worker owns a deque: it pushes and pops its own tasks at the back and
+// steals from the front of the others when it runs dry. Tasks forked from outside
+// the pool are dealt round-robin over the deques. A thread blocked in join()
+// runs queued tasks itself until the one it waits for is done, so nested
+// fork/join (a task that forks and joins its own subtasks) cannot deadlock.
+//
+// With neither backend selected nothing is defined here; the no-OS fallback in
+// mythread_noos.h keeps running tasks synchronously.
+
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#if defined(USE_STD_THREAD) || defined(USE_POSIX)
+
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include <unistd.h>
+#if defined(USE_STD_THREAD)
+  #include <condition_variable>
+  #include <mutex>
+  #include <thread>
+#else
+  #include <pthread.h>
+#endif
+
+namespace WorkPool {
+
+// ---- backend primitives ----
+#if defined(USE_STD_THREAD)
+class Lock {
+public:
+    void lock() { m_.lock(); }
+    void unlock() { m_.unlock(); }
+private:
+    friend class Signal;
+    std::mutex m_;
+};
+
+class Signal {
+public:
+    // 'l' must be held; it is released while waiting and held again on return
+    void wait(Lock &l) {
+        std::unique_lock<std::mutex> g(l.m_, std::adopt_lock);
+        cv_.wait(g);
+        g.release();
+    }
+    void notify_one() { cv_.notify_one(); }
+    void notify_all() { cv_.notify_all(); }
+private:
+    std::condition_variable cv_;
+};
+
+class OsThread {
+public:
+    void start(std::function<void()> f) { t_ = std::thread(std::move(f)); }
+    void join() { if (t_.joinable()) t_.join(); }
+private:
+    std::thread t_;
+};
+#else
+class Lock {
+public:
+    Lock() { pthread_mutex_init(&m_, nullptr); }
+    ~Lock() { pthread_mutex_destroy(&m_); }
+    void lock() { pthread_mutex_lock(&m_); }
+    void unlock() { pthread_mutex_unlock(&m_); }
+    Lock(const Lock&) = delete;
+    Lock& operator=(const Lock&) = delete;
+private:
+    friend class Signal;
+    pthread_mutex_t m_;
+};
+
+class Signal {
+public:
+    Signal() { pthread_cond_init(&c_, nullptr); }
+    ~Signal() { pthread_cond_destroy(&c_); }
+    // 'l' must be held; it is released while waiting and held again on return
+    void wait(Lock &l) { pthread_cond_wait(&c_, &l.m_); }
+    void notify_one() { pthread_cond_signal(&c_); }
+    void notify_all() { pthread_cond_broadcast(&c_); }
+    Signal(const Signal&) = delete;
+    Signal& operator=(const Signal&) = delete;
+private:
+    pthread_cond_t c_;
+};
+
+class OsThread {
+public:
+    void start(std::function<void()> f) {
+        auto fn = new std::function<void()>(std::move(f));
+        if (pthread_create(&t_, nullptr, &OsThread::entry, fn) != 0) { delete fn; throw std::runtime_error("pthread_create failed"); }
+        started_ = true;
+    }
+    void join() { if (started_) { pthread_join(t_, nullptr); started_ = false; } }
+private:
+    static void* entry(void *arg) {
+        std::unique_ptr<std::function<void()>> fn(static_cast<std::function<void()>*>(arg));
+        (*fn)();
+        return nullptr;
+    }
+    pthread_t t_;
+    bool started_ = false;
+};
+#endif
+
+class Guard {
+public:
+    explicit Guard(Lock &l) : l_(l) { l_.lock(); }
+    ~Guard() { l_.unlock(); }
+    Guard(const Guard&) = delete;
+    Guard& operator=(const Guard&) = delete;
+private:
+    Lock &l_;
+};
+
+// One forked task. An exception thrown by it is handed to whoever joins it.
+struct Job {
+    std::function<void()> fn;
+    std::atomic<bool> done{false};
+    std::exception_ptr error;
+};
+using JobPtr = std::shared_ptr<Job>;
+
+class Pool {
+public:
+    // The process-wide pool, started on first use with one worker per online
+    // CPU. The programs call this once at startup so no menu action pays for it.
+    static Pool& instance() {
+        static Pool pool(default_workers());
+        return pool;
+    }
+
+    static size_t default_workers() {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        return n > 0 ? (size_t)n : 1;
+    }
+
+    size_t size() const { return threads_.size(); }
+
+    JobPtr fork(std::function<void()> fn) {
+        auto job = std::make_shared<Job>();
+        job->fn = std::move(fn);
+        size_t q = self_ < queues_.size() ? self_ : next_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+        {
+            Guard g(queues_[q]->lock);
+            queues_[q]->jobs.push_back(job);
+        }
+        pending_.fetch_add(1);
+        { Guard g(idle_lock_); }
+        idle_.notify_one();
+        return job;
+    }
+
+    // Run queued tasks until 'job' has finished, then rethrow its exception.
+    void join(const JobPtr &job) {
+        while (!job->done.load(std::memory_order_acquire)) {
+            if (run_one()) continue;
+            Guard g(idle_lock_);
+            while (!job->done.load(std::memory_order_acquire) && pending_.load() == 0) idle_.wait(idle_lock_);
+        }
+        if (job->error) {
+            std::exception_ptr e = job->error;
+            job->error = nullptr;
+            std::rethrow_exception(e);
+        }
+    }
+
+    ~Pool() {
+        {
+            Guard g(idle_lock_);
+            stop_ = true;
+        }
+        idle_.notify_all();
+        for (auto &t : threads_) t.join();
+    }
+
+    Pool(const Pool&) = delete;
+    Pool& operator=(const Pool&) = delete;
+
+private:
+    struct Queue {
+        Lock lock;
+        std::deque<JobPtr> jobs;
+    };
+
+    explicit Pool(size_t workers) : threads_(workers < 1 ? 1 : workers) {
+        for (size_t i = 0; i < threads_.size(); ++i) queues_.push_back(std::make_unique<Queue>());
+        for (size_t i = 0; i < threads_.size(); ++i) threads_[i].start([this, i]{ worker_loop(i); });
+    }
+
+    // Pop from our own deque (newest first), else steal the oldest task of
+    // another one. Returns false when every deque was empty.
+    bool run_one() {
+        JobPtr job;
+        size_t n = queues_.size();
+        if (self_ < n) {
+            Queue &q = *queues_[self_];
+            Guard g(q.lock);
+            if (!q.jobs.empty()) { job = std::move(q.jobs.back()); q.jobs.pop_back(); }
+        }
+        for (size_t k = 1; !job && k <= n; ++k) {
+            Queue &q = *queues_[((self_ < n ? self_ : 0) + k) % n];
+            Guard g(q.lock);
+            if (!q.jobs.empty()) { job = std::move(q.jobs.front()); q.jobs.pop_front(); }
+        }
+        if (!job) return false;
+        pending_.fetch_sub(1);
+        try { job->fn(); } catch (...) { job->error = std::current_exception(); }
+        job->fn = nullptr;
+        job->done.store(true, std::memory_order_release);
+        { Guard g(idle_lock_); }
+        idle_.notify_all(); // wake joiners waiting for this task
+        return true;
+    }
+
+    void worker_loop(size_t self) {
+        self_ = self;
+        for (;;) {
+            if (run_one()) continue;
+            Guard g(idle_lock_);
+            while (!stop_ && pending_.load() == 0) idle_.wait(idle_lock_);
+            if (stop_ && pending_.load() == 0) return;
+        }
+    }
+
+    std::vector<OsThread> threads_;
+    std::vector<std::unique_ptr<Queue>> queues_; // queues_[i] belongs to worker i
+    std::atomic<size_t> pending_{0};             // tasks sitting in any deque
+    std::atomic<size_t> next_{0};                // round robin for outside forks
+    Lock idle_lock_;
+    Signal idle_;
+    bool stop_ = false;
+    static inline thread_local size_t self_ = (size_t)-1; // worker index, or -1 outside the pool
+};
+
+} // namespace WorkPool
+
+#endif // USE_STD_THREAD || USE_POSIX
+
+#endif // WORKPOOL_H